@@ -0,0 +1,105 @@
+// Per-request parse and encode cost: nlohmann DOM versus the typed SAX decoder
+// and precomputed response fragments used by the server.
+
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "src/request_codec.h"
+
+using json = nlohmann::json;
+
+namespace
+{
+    const std::string bookingBody =
+        R"({"flight_id":42,"passenger_name":"Ada Lovelace",)"
+        R"("passenger_email":"ada@example.com","seat_number":17})";
+
+    const std::string flightBody =
+        R"({"flight_number":"AF1234","destination":"Paris","departure_date":"2026-11-02",)"
+        R"("total_seats":180,"class_type":"Economy","price":249.5})";
+
+    volatile size_t sink;
+
+    template <typename Fn>
+    void run(const char *label, int iterations, Fn fn)
+    {
+        for (int i = 0; i < iterations / 10; ++i)
+        {
+            fn();
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            fn();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+        std::printf("%-40s %10.1f ns/op\n", label, ns);
+    }
+}
+
+int main()
+{
+    const int iterations = 200000;
+
+    run("parse booking: json::parse + operator[]", iterations, []
+        {
+        auto requestJson = json::parse(bookingBody);
+        int flightId = requestJson["flight_id"];
+        std::string passengerName = requestJson["passenger_name"];
+        std::string passengerEmail = requestJson["passenger_email"];
+        int seatNumber = requestJson["seat_number"];
+        sink = flightId + seatNumber + passengerName.size() + passengerEmail.size(); });
+
+    run("parse booking: decodeRequest", iterations, []
+        {
+        BookingRequest request;
+        std::string error;
+        decodeRequest(bookingBody, request, error);
+        sink = request.flightId + request.seatNumber + request.passengerName.size() + request.passengerEmail.size(); });
+
+    run("parse flight: json::parse + operator[]", iterations, []
+        {
+        auto requestJson = json::parse(flightBody);
+        std::string flightNumber = requestJson["flight_number"];
+        int totalSeats = requestJson["total_seats"];
+        double price = requestJson["price"];
+        sink = flightNumber.size() + totalSeats + static_cast<size_t>(price); });
+
+    run("parse flight: decodeRequest", iterations, []
+        {
+        AddFlightRequest request;
+        std::string error;
+        decodeRequest(flightBody, request, error);
+        sink = request.flightNumber.size() + request.totalSeats + static_cast<size_t>(request.price); });
+
+    run("encode success: json{}.dump()", iterations, []
+        {
+        json response = {
+            {"success", true},
+            {"message", "Flight booked successfully"}};
+        std::string body = response.dump();
+        sink = body.size(); });
+
+    // The copy every fixed response pays when it is assigned to res.body
+    run("encode success: copy of fragment", iterations, []
+        {
+        std::string body = JsonResponse::bookingSucceeded;
+        sink = body.size(); });
+
+    run("encode error: json{}.dump()", iterations, []
+        {
+        json error = {{"error", std::string("Error: ") + "database is locked"}};
+        std::string body = error.dump();
+        sink = body.size(); });
+
+    run("encode error: JsonResponse::writeError", iterations, []
+        {
+        std::string body;
+        JsonResponse::writeError(body, "Error: ", "database is locked");
+        sink = body.size(); });
+
+    return 0;
+}
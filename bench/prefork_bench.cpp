@@ -0,0 +1,140 @@
+// Shared-memory paths of the pre-fork server run from 1 and from N forked worker
+// processes at once: seat claims, the analytics counter updates that follow a
+// booking, and shared rate limit budgets. Times are wall clock per operation
+// across all workers, so a path that scales shows a lower figure with more
+// workers and one that contends on a cache line a higher one. Linux only.
+//
+//   prefork_bench [workers]   (default: 4)
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/rate_limiter.h"
+#include "src/seat_inventory.h"
+
+namespace
+{
+    // Start line shared with the forked workers, so process start-up is not timed
+    struct Barrier
+    {
+        std::atomic<int> ready;
+        std::atomic<int> go;
+    };
+
+    Barrier *barrier;
+
+    template <typename Fn>
+    void run(const char *label, int workers, int iterations, Fn fn)
+    {
+        barrier->ready.store(0);
+        barrier->go.store(0);
+        std::vector<pid_t> pids;
+        for (int w = 0; w < workers; ++w)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                barrier->ready.fetch_add(1);
+                while (!barrier->go.load())
+                {
+                }
+                for (int i = 0; i < iterations; ++i)
+                {
+                    fn(w, i);
+                }
+                _exit(0);
+            }
+            pids.push_back(pid);
+        }
+        while (barrier->ready.load() != workers)
+        {
+            std::this_thread::yield();
+        }
+        auto start = std::chrono::steady_clock::now();
+        barrier->go.store(1);
+        for (pid_t pid : pids)
+        {
+            waitpid(pid, nullptr, 0);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count() / (static_cast<double>(iterations) * workers);
+        std::string name = std::string(label) + ", " + std::to_string(workers) + (workers == 1 ? " worker" : " workers");
+        std::printf("%-48s %10.1f ns/op\n", name.c_str(), ns);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const int workers = argc > 1 ? std::max(1, std::atoi(argv[1])) : 4;
+    const int iterations = 2000000;
+
+    void *mapping = mmap(nullptr, sizeof(Barrier), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        std::perror("mmap");
+        return 1;
+    }
+    barrier = new (mapping) Barrier();
+
+    SeatInventory inventory;
+    SharedRateLimits rateLimits;
+    if (!inventory.create(1024, workers) || !rateLimits.create(65536, RateLimiter::nowNs()))
+    {
+        std::fprintf(stderr, "shared memory unavailable\n");
+        return 1;
+    }
+    for (int flight = 1; flight <= 64; ++flight)
+    {
+        inventory.addFlight(flight, 1000, 199.0);
+    }
+
+    for (int n : {1, workers})
+    {
+        // Every worker on one flight: claims contend on the same seat words
+        run("claim+release, one flight", n, iterations, [&](int w, int i)
+            {
+            inventory.attachWorker(w);
+            SeatInventory::Update update(&inventory);
+            int seat = (i * 7 + w * 131) % 1000 + 1;
+            if (inventory.claim(1, seat) == SeatInventory::Claim::Claimed)
+                inventory.release(1, seat); });
+
+        // Each worker on its own flights
+        run("claim+release, own flights", n, iterations, [&](int w, int i)
+            {
+            inventory.attachWorker(w);
+            SeatInventory::Update update(&inventory);
+            int flight = w * 8 + i % 8 + 1;
+            int seat = (i * 7) % 1000 + 1;
+            if (inventory.claim(flight, seat) == SeatInventory::Claim::Claimed)
+                inventory.release(flight, seat); });
+
+        // What every committed booking costs the analytics in pre-fork mode
+        run("analytics counters per booking", n, iterations, [&](int w, int i)
+            {
+            inventory.addBookings(w * 8 + i % 8 + 1, 1);
+            inventory.addDayBookings(20261019, 1);
+            inventory.noteBookingChange(); });
+
+        // Distinct clients, so the budget check is one CAS on an entry per client
+        RateLimitOptions options;
+        options.booking = {1e9, 1e9};
+        RateLimiter limiter(options);
+        limiter.share(&rateLimits);
+        run("shared rate limit acquire", n, iterations / 4, [&](int w, int i)
+            {
+            limiter.acquire(RouteClass::BookingWrite, "acct:" + std::to_string(w * 4096 + i % 4096)); });
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Seat block search on a 500-seat, 3-4-3 cabin at several load factors, including
+// the worst case where no block exists and every row and the aisle fallback are scanned.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "src/seat_map.h"
+
+namespace
+{
+    volatile size_t sink;
+
+    template <typename Fn>
+    void run(const char *label, int iterations, Fn fn)
+    {
+        for (int i = 0; i < iterations / 10; ++i)
+        {
+            fn();
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            fn();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+        std::printf("%-40s %10.1f ns/op\n", label, ns);
+    }
+
+    // Deterministic scatter of taken seats covering roughly `percent` of the cabin
+    SeatOccupancy occupied(const SeatLayout &layout, int percent)
+    {
+        SeatOccupancy occupancy(layout);
+        uint32_t state = 12345;
+        for (int seat = 1; seat <= layout.capacity(); ++seat)
+        {
+            state = state * 1664525u + 1013904223u;
+            if (static_cast<int>((state >> 16) % 100) < percent)
+            {
+                occupancy.markTaken(seat);
+            }
+        }
+        return occupancy;
+    }
+}
+
+int main()
+{
+    const int iterations = 200000;
+    SeatLayout layout = SeatLayout::forCapacity(500, "Economy");
+    std::vector<int> seats;
+
+    SeatOccupancy empty = occupied(layout, 0);
+    SeatOccupancy half = occupied(layout, 50);
+    SeatOccupancy nearlyFull = occupied(layout, 90);
+
+    // Every other seat taken: no two adjacent seats anywhere
+    SeatOccupancy alternating(layout);
+    for (int seat = 1; seat <= layout.capacity(); seat += 2)
+    {
+        alternating.markTaken(seat);
+    }
+
+    run("party of 3, empty cabin", iterations, [&]
+        { sink = SeatAssigner::findBlock(layout, empty, 3, "", seats); });
+    run("party of 3, 50% taken", iterations, [&]
+        { sink = SeatAssigner::findBlock(layout, half, 3, "", seats); });
+    run("party of 2, 90% taken", iterations, [&]
+        { sink = SeatAssigner::findBlock(layout, nearlyFull, 2, "", seats); });
+    run("party of 5, 50% taken (crosses aisle)", iterations, [&]
+        { sink = SeatAssigner::findBlock(layout, half, 5, "", seats); });
+    run("party of 2, no block (full scan)", iterations, [&]
+        { sink = SeatAssigner::findBlock(layout, alternating, 2, "", seats); });
+
+    return 0;
+}
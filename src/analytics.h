@@ -0,0 +1,279 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Occupancy and revenue aggregates, kept up to date on every committed booking,
+// cancellation and reschedule so the analytics endpoints never scan the bookings
+// table. A booking counts as active while its status is not CANCELLED, which is
+// the same rule /api/bookings uses. Pre-fork workers keep the counts in shared
+// memory instead and copy them in with replaceCounts().
+class BookingAnalytics
+{
+private:
+    struct FlightStats
+    {
+        std::string flightNumber;
+        std::string destination;
+        std::string departureDate;
+        int totalSeats = 0;
+        double price = 0.0;
+        int activeBookings = 0;
+    };
+
+    struct DestinationStats
+    {
+        int activeBookings = 0;
+        double revenue = 0.0;
+    };
+
+    // Serialised view, rebuilt only when the aggregates changed since it was last built
+    struct CachedBody
+    {
+        uint64_t version = UINT64_MAX;
+        std::string body;
+    };
+
+    std::mutex mutex;
+    std::map<int, FlightStats> flights;
+    std::map<std::string, DestinationStats> destinations;
+    std::map<std::string, int> bookingsPerDay;
+    uint64_t version = 0;
+    CachedBody flightsCache;
+    CachedBody destinationsCache;
+    CachedBody velocityCache;
+
+    void adjust(int flightId, int delta)
+    {
+        auto it = flights.find(flightId);
+        if (it == flights.end())
+        {
+            return;
+        }
+        it->second.activeBookings += delta;
+        DestinationStats &destination = destinations[it->second.destination];
+        destination.activeBookings += delta;
+        destination.revenue += delta * it->second.price;
+    }
+
+    template <typename Build>
+    std::string cached(CachedBody &cache, Build build)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cache.version != version)
+        {
+            cache.body = build().dump();
+            cache.version = version;
+        }
+        return cache.body;
+    }
+
+public:
+    // "YYYY-MM-DD" in local time, matching the ctime() stamps stored in booking_date
+    static std::string dayKey(time_t when)
+    {
+        std::tm local{};
+#ifdef _WIN32
+        localtime_s(&local, &when);
+#else
+        localtime_r(&when, &local);
+#endif
+        char buffer[16];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d", &local);
+        return buffer;
+    }
+
+    // Parses a ctime() stamp such as "Mon Oct 19 05:00:09 2026" into "2026-10-19"
+    static std::string dayKeyFromCtime(const std::string &stamp)
+    {
+        static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+        char month[4] = {};
+        int day = 0, year = 0;
+        if (std::sscanf(stamp.c_str(), "%*3s %3s %d %*d:%*d:%*d %d", month, &day, &year) != 3)
+        {
+            return "unknown";
+        }
+        const char *found = std::strstr(months, month);
+        if (!found || (found - months) % 3 != 0)
+        {
+            return "unknown";
+        }
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, static_cast<int>((found - months) / 3) + 1, day);
+        return buffer;
+    }
+
+    // "2026-10-19" -> 20261019, the day key the shared counters use; -1 for "unknown"
+    static int32_t dayNumber(const std::string &key)
+    {
+        int year = 0, month = 0, day = 0;
+        if (std::sscanf(key.c_str(), "%d-%d-%d", &year, &month, &day) != 3)
+        {
+            return -1;
+        }
+        return year * 10000 + month * 100 + day;
+    }
+
+    static std::string dayKeyFromNumber(int32_t number)
+    {
+        if (number < 0)
+        {
+            return "unknown";
+        }
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", number / 10000, number / 100 % 100, number % 100);
+        return buffer;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        flights.clear();
+        destinations.clear();
+        bookingsPerDay.clear();
+        ++version;
+    }
+
+    void addFlight(int flightId, const std::string &flightNumber, const std::string &destination,
+                   const std::string &departureDate, int totalSeats, double price)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        FlightStats &stats = flights[flightId];
+        stats.flightNumber = flightNumber;
+        stats.destination = destination;
+        stats.departureDate = departureDate;
+        stats.totalSeats = totalSeats;
+        stats.price = price;
+        destinations[destination];
+        ++version;
+    }
+
+    bool hasFlight(int flightId)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return flights.count(flightId) != 0;
+    }
+
+    struct FlightCount
+    {
+        int flightId;
+        int activeBookings;
+        double revenue;
+    };
+
+    // Replaces every count with ones kept elsewhere, leaving the flight details.
+    // Flights missing from `counts` have no active bookings; counts for flights
+    // not added here are dropped.
+    void replaceCounts(const std::vector<FlightCount> &counts, std::map<std::string, int> perDay)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &[flightId, stats] : flights)
+        {
+            stats.activeBookings = 0;
+        }
+        for (auto &[name, stats] : destinations)
+        {
+            stats = DestinationStats();
+        }
+        for (const FlightCount &count : counts)
+        {
+            auto it = flights.find(count.flightId);
+            if (it == flights.end())
+            {
+                continue;
+            }
+            it->second.activeBookings = count.activeBookings;
+            DestinationStats &destination = destinations[it->second.destination];
+            destination.activeBookings += count.activeBookings;
+            destination.revenue += count.revenue;
+        }
+        bookingsPerDay = std::move(perDay);
+        ++version;
+    }
+
+    // A newly committed booking, or any booking row loaded during a rebuild.
+    // Velocity counts every booking made on `day`, even if later cancelled.
+    void bookingAdded(int flightId, const std::string &day, bool active = true)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (active)
+        {
+            adjust(flightId, +1);
+        }
+        ++bookingsPerDay[day];
+        ++version;
+    }
+
+    void bookingCancelled(int flightId)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        adjust(flightId, -1);
+        ++version;
+    }
+
+    // Reschedule reactivates the booking on the new flight whatever its old status
+    void bookingMoved(int oldFlightId, bool wasActive, int newFlightId)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (wasActive)
+        {
+            adjust(oldFlightId, -1);
+        }
+        adjust(newFlightId, +1);
+        ++version;
+    }
+
+    std::string flightsJson()
+    {
+        return cached(flightsCache, [this]
+                      {
+            nlohmann::json rows = nlohmann::json::array();
+            for (const auto &[flightId, stats] : flights)
+            {
+                rows.push_back({
+                    {"flight_id", flightId},
+                    {"flight_number", stats.flightNumber},
+                    {"destination", stats.destination},
+                    {"departure_date", stats.departureDate},
+                    {"total_seats", stats.totalSeats},
+                    {"booked_seats", stats.activeBookings},
+                    {"load_factor", stats.totalSeats > 0 ? static_cast<double>(stats.activeBookings) / stats.totalSeats : 0.0}});
+            }
+            return rows; });
+    }
+
+    std::string destinationsJson()
+    {
+        return cached(destinationsCache, [this]
+                      {
+            nlohmann::json rows = nlohmann::json::array();
+            for (const auto &[destination, stats] : destinations)
+            {
+                rows.push_back({
+                    {"destination", destination},
+                    {"bookings", stats.activeBookings},
+                    {"revenue", stats.revenue}});
+            }
+            return rows; });
+    }
+
+    std::string velocityJson()
+    {
+        return cached(velocityCache, [this]
+                      {
+            nlohmann::json rows = nlohmann::json::array();
+            for (const auto &[day, count] : bookingsPerDay)
+            {
+                rows.push_back({{"date", day}, {"bookings", count}});
+            }
+            return rows; });
+    }
+};
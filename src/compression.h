@@ -0,0 +1,292 @@
+#pragma once
+
+#include <httplib.h>
+#include <zlib.h>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+struct CompressionOptions
+{
+    bool enabled = true;
+    size_t minBytes = 1024; // smaller bodies are sent as-is
+    int level = 6;          // zlib level, 1 (fastest) .. 9 (smallest)
+};
+
+enum class ContentCoding
+{
+    Identity,
+    Gzip,
+    Deflate
+};
+
+// Picks a coding from an Accept-Encoding header, honouring q-values. gzip wins ties.
+inline ContentCoding negotiateEncoding(std::string_view acceptEncoding)
+{
+    double gzipQ = -1.0, deflateQ = -1.0, wildcardQ = -1.0;
+
+    while (!acceptEncoding.empty())
+    {
+        size_t comma = acceptEncoding.find(',');
+        std::string_view item = acceptEncoding.substr(0, comma);
+        acceptEncoding = comma == std::string_view::npos ? std::string_view() : acceptEncoding.substr(comma + 1);
+
+        size_t semicolon = item.find(';');
+        std::string_view coding = item.substr(0, semicolon);
+        while (!coding.empty() && (coding.front() == ' ' || coding.front() == '\t'))
+            coding.remove_prefix(1);
+        while (!coding.empty() && (coding.back() == ' ' || coding.back() == '\t'))
+            coding.remove_suffix(1);
+
+        double q = 1.0;
+        if (semicolon != std::string_view::npos)
+        {
+            std::string_view params = item.substr(semicolon + 1);
+            size_t qPos = params.find("q=");
+            if (qPos != std::string_view::npos)
+            {
+                q = std::strtod(std::string(params.substr(qPos + 2)).c_str(), nullptr);
+            }
+        }
+
+        if (coding == "gzip" || coding == "x-gzip")
+            gzipQ = q;
+        else if (coding == "deflate")
+            deflateQ = q;
+        else if (coding == "*")
+            wildcardQ = q;
+    }
+
+    if (gzipQ < 0)
+        gzipQ = wildcardQ;
+    if (deflateQ < 0)
+        deflateQ = wildcardQ;
+
+    if (gzipQ > 0 && gzipQ >= deflateQ)
+        return ContentCoding::Gzip;
+    if (deflateQ > 0)
+        return ContentCoding::Deflate;
+    return ContentCoding::Identity;
+}
+
+inline const char *contentCodingName(ContentCoding coding)
+{
+    return coding == ContentCoding::Gzip ? "gzip" : "deflate";
+}
+
+class ZlibStream
+{
+private:
+    z_stream stream{};
+    bool initialised = false;
+
+public:
+    ZlibStream(ContentCoding coding, int level)
+    {
+        // 15 window bits emits a zlib wrapper ("deflate"), +16 a gzip wrapper
+        int windowBits = coding == ContentCoding::Gzip ? 15 + 16 : 15;
+        if (deflateInit2(&stream, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            throw std::runtime_error("Failed to initialise zlib stream");
+        }
+        initialised = true;
+    }
+
+    ZlibStream(const ZlibStream &) = delete;
+    ZlibStream &operator=(const ZlibStream &) = delete;
+
+    ~ZlibStream()
+    {
+        if (initialised)
+        {
+            deflateEnd(&stream);
+        }
+    }
+
+    void reset()
+    {
+        deflateReset(&stream);
+    }
+
+    // Appends the compressed form of `data` to `out`. `flush` is Z_NO_FLUSH,
+    // Z_SYNC_FLUSH (emit everything so far, for chunked bodies) or Z_FINISH.
+    bool write(const char *data, size_t length, std::string &out, int flush)
+    {
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        stream.avail_in = static_cast<uInt>(length);
+
+        char buffer[16384];
+        int rc;
+        do
+        {
+            stream.next_out = reinterpret_cast<Bytef *>(buffer);
+            stream.avail_out = sizeof(buffer);
+            rc = deflate(&stream, flush);
+            if (rc == Z_STREAM_ERROR)
+            {
+                return false;
+            }
+            out.append(buffer, sizeof(buffer) - stream.avail_out);
+        } while (stream.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+
+        return true;
+    }
+};
+
+class ResponseCompressor
+{
+private:
+    CompressionOptions options;
+    std::atomic<uint64_t> responsesCompressed{0};
+    std::atomic<uint64_t> bytesIn{0};
+    std::atomic<uint64_t> bytesOut{0};
+
+    // deflateInit allocates a few hundred KB, so each handler thread keeps one
+    // stream per coding and resets it between responses.
+    ZlibStream &threadStream(ContentCoding coding)
+    {
+        thread_local std::unique_ptr<ZlibStream> gzip;
+        thread_local std::unique_ptr<ZlibStream> deflate;
+        std::unique_ptr<ZlibStream> &slot = coding == ContentCoding::Gzip ? gzip : deflate;
+        if (!slot)
+        {
+            slot = std::make_unique<ZlibStream>(coding, options.level);
+        }
+        else
+        {
+            slot->reset();
+        }
+        return *slot;
+    }
+
+    ContentCoding chooseCoding(const httplib::Request &req, const httplib::Response &res) const
+    {
+        if (!options.enabled || res.has_header("Content-Encoding"))
+        {
+            return ContentCoding::Identity;
+        }
+        return negotiateEncoding(req.get_header_value("Accept-Encoding"));
+    }
+
+    void record(size_t originalSize, size_t compressedSize)
+    {
+        responsesCompressed.fetch_add(1, std::memory_order_relaxed);
+        bytesIn.fetch_add(originalSize, std::memory_order_relaxed);
+        bytesOut.fetch_add(compressedSize, std::memory_order_relaxed);
+    }
+
+public:
+    explicit ResponseCompressor(const CompressionOptions &options = {}) : options(options) {}
+
+    // Post-routing hook: compresses a fully buffered API body in place. Runs after
+    // httplib has set Content-Length, so that header is rewritten as well.
+    void apply(const httplib::Request &req, httplib::Response &res)
+    {
+        if (res.body.size() < options.minBytes || req.path.compare(0, 5, "/api/") != 0)
+        {
+            return;
+        }
+        ContentCoding coding = chooseCoding(req, res);
+        if (coding == ContentCoding::Identity)
+        {
+            return;
+        }
+
+        std::string compressed;
+        compressed.reserve(res.body.size() / 4);
+        if (!threadStream(coding).write(res.body.data(), res.body.size(), compressed, Z_FINISH) ||
+            compressed.size() >= res.body.size())
+        {
+            return;
+        }
+
+        record(res.body.size(), compressed.size());
+        res.body.swap(compressed);
+        res.headers.erase("Content-Length");
+        res.set_header("Content-Length", std::to_string(res.body.size()));
+        res.set_header("Content-Encoding", contentCodingName(coding));
+        res.set_header("Vary", "Accept-Encoding");
+    }
+
+    // Streams a chunked body through the negotiated coding. Each chunk the provider
+    // writes is sync-flushed so the client can start decoding before the end. The
+    // body never reaches res.body, so apply() leaves these responses alone.
+    void setChunkedContent(const httplib::Request &req, httplib::Response &res, const char *contentType,
+                           httplib::ContentProviderWithoutLength provider)
+    {
+        ContentCoding coding = chooseCoding(req, res);
+        if (coding == ContentCoding::Identity)
+        {
+            res.set_chunked_content_provider(contentType, std::move(provider));
+            return;
+        }
+
+        struct StreamState
+        {
+            ZlibStream zlib;
+            httplib::ContentProviderWithoutLength provider;
+            httplib::DataSink *outer = nullptr;
+            httplib::DataSink inner;
+            std::string buffer;
+            size_t offset = 0;
+            size_t compressedSize = 0;
+
+            StreamState(ContentCoding coding, int level) : zlib(coding, level) {}
+        };
+
+        // A stream of its own: the provider runs across several writes, between
+        // which this thread's stream may serve another response
+        auto state = std::make_shared<StreamState>(coding, options.level);
+        state->provider = std::move(provider);
+        StreamState *raw = state.get();
+
+        state->inner.write = [raw](const char *data, size_t length)
+        {
+            raw->buffer.clear();
+            if (!raw->zlib.write(data, length, raw->buffer, Z_SYNC_FLUSH))
+            {
+                return false;
+            }
+            raw->offset += length;
+            raw->compressedSize += raw->buffer.size();
+            return raw->buffer.empty() || raw->outer->write(raw->buffer.data(), raw->buffer.size());
+        };
+        state->inner.is_writable = [raw]()
+        {
+            return raw->outer->is_writable();
+        };
+        state->inner.done = [this, raw]()
+        {
+            raw->buffer.clear();
+            raw->zlib.write(nullptr, 0, raw->buffer, Z_FINISH);
+            raw->compressedSize += raw->buffer.size();
+            if (!raw->buffer.empty())
+            {
+                raw->outer->write(raw->buffer.data(), raw->buffer.size());
+            }
+            record(raw->offset, raw->compressedSize);
+            raw->outer->done();
+        };
+
+        res.set_header("Content-Encoding", contentCodingName(coding));
+        res.set_header("Vary", "Accept-Encoding");
+        res.set_chunked_content_provider(contentType, [state](size_t, httplib::DataSink &sink)
+                                         {
+            state->outer = &sink;
+            return state->provider(state->offset, state->inner); });
+    }
+
+    uint64_t compressedResponses() const { return responsesCompressed.load(std::memory_order_relaxed); }
+    uint64_t uncompressedBytes() const { return bytesIn.load(std::memory_order_relaxed); }
+    uint64_t compressedBytes() const { return bytesOut.load(std::memory_order_relaxed); }
+
+    // Compressed size as a fraction of the original; 1.0 until something is compressed.
+    double compressionRatio() const
+    {
+        uint64_t in = uncompressedBytes();
+        return in == 0 ? 1.0 : static_cast<double>(compressedBytes()) / static_cast<double>(in);
+    }
+};
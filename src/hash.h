@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a. Used for idempotency fingerprints and for comparing response
+// bodies between capture and replay; not for anything an attacker can aim at.
+inline uint64_t fnv1a64(std::string_view data)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "hash.h"
+
+struct IdempotencyOptions
+{
+    bool enabled = true;
+    int64_t ttlSeconds = 24 * 60 * 60; // how long a stored response is replayed
+    size_t maxEntries = 65536;         // in memory, across all shards; older keys fall back to the table
+    int waitSeconds = 30;              // how long a duplicate waits for the original to finish
+    int64_t leaseSeconds = 60;         // a claim in the shared table not finished by then is presumed orphaned
+};
+
+struct StoredResponse
+{
+    int status = 0;
+    std::string body;
+};
+
+// What the idempotency_keys table, which all worker processes share, held for a
+// key when a request tried to claim it there
+enum class TableClaim
+{
+    Claimed, // nothing live: the caller now holds a pending row and runs the request
+    Stored,  // a finished response is stored
+    Pending  // another request, possibly in another worker, is still running it
+};
+
+// In-memory results for requests sent with an Idempotency-Key. The first request
+// with a key claims it and runs; duplicates that arrive while it is running block
+// on the claim and then replay its response, and later retries replay it straight
+// from the cache. A key reused with a different request is reported as a mismatch.
+// Each shard keeps its keys in claim order, which is also expiry order, so eviction
+// only ever looks at the front.
+class IdempotencyCache
+{
+public:
+    static constexpr size_t maxKeyLength = 255;
+
+    enum class Outcome
+    {
+        Execute,    // caller owns the key: run the request, then complete() or abandon()
+        Replay,     // `response` holds the stored result
+        Mismatch,   // key already used for a different request
+        InProgress  // the original is still running after waitSeconds
+    };
+
+    class Entry
+    {
+    private:
+        friend class IdempotencyCache;
+
+        enum class State
+        {
+            InFlight,
+            Done,
+            Abandoned
+        };
+
+        uint64_t id;
+        uint64_t fingerprint;
+        int64_t expiresAt = 0;
+        State state = State::InFlight;
+        StoredResponse response;
+        std::condition_variable finished;
+
+    public:
+        Entry(uint64_t id, uint64_t fingerprint) : id(id), fingerprint(fingerprint) {}
+    };
+
+    struct Claim
+    {
+        Outcome outcome;
+        std::shared_ptr<Entry> entry;
+        StoredResponse response;
+    };
+
+private:
+    static constexpr size_t shardCount = 64;
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+        std::deque<std::pair<std::string, uint64_t>> order; // key and entry id, oldest first
+        uint64_t nextId = 0;
+    };
+
+    IdempotencyOptions options;
+    size_t shardCapacity;
+    Shard shards[shardCount];
+    std::atomic<uint64_t> replays{0};
+    std::atomic<uint64_t> waits{0};
+
+    Shard &shardFor(const std::string &key)
+    {
+        return shards[std::hash<std::string>{}(key) % shardCount];
+    }
+
+    // Drops expired or excess keys from the front. An in-flight key is never
+    // dropped, since a duplicate arriving after that would run the request again.
+    void evict(Shard &shard, int64_t now)
+    {
+        while (!shard.order.empty())
+        {
+            const auto &[key, id] = shard.order.front();
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end() && it->second->id == id)
+            {
+                const Entry &entry = *it->second;
+                if (entry.state == Entry::State::InFlight)
+                    break;
+                if (shard.entries.size() <= shardCapacity && entry.expiresAt > now)
+                    break;
+                shard.entries.erase(it);
+            }
+            shard.order.pop_front();
+        }
+    }
+
+public:
+    explicit IdempotencyCache(const IdempotencyOptions &options = {})
+        : options(options), shardCapacity(options.maxEntries / shardCount > 0 ? options.maxEntries / shardCount : 1) {}
+
+    static int64_t nowSeconds()
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // Identifies the request a key was first used with
+    static uint64_t fingerprint(const std::string &method, const std::string &path, const std::string &body)
+    {
+        std::string request;
+        request.reserve(method.size() + path.size() + body.size() + 2);
+        request += method;
+        request += '\n';
+        request += path;
+        request += '\n';
+        request += body;
+        return fnv1a64(request);
+    }
+
+    int64_t expiryFrom(int64_t now) const { return now + options.ttlSeconds; }
+
+    Claim claim(const std::string &key, uint64_t fingerprint, int64_t now = nowSeconds())
+    {
+        Shard &shard = shardFor(key);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(options.waitSeconds);
+        bool waited = false;
+
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        for (;;)
+        {
+            auto it = shard.entries.find(key);
+            if (it == shard.entries.end() ||
+                (it->second->state == Entry::State::Done && it->second->expiresAt <= now))
+            {
+                auto entry = std::make_shared<Entry>(++shard.nextId, fingerprint);
+                shard.entries[key] = entry;
+                shard.order.emplace_back(key, entry->id);
+                evict(shard, now);
+                return {Outcome::Execute, entry, {}};
+            }
+
+            std::shared_ptr<Entry> entry = it->second;
+            if (entry->fingerprint != fingerprint)
+            {
+                return {Outcome::Mismatch, nullptr, {}};
+            }
+            if (entry->state == Entry::State::Done)
+            {
+                replays.fetch_add(1, std::memory_order_relaxed);
+                return {Outcome::Replay, nullptr, entry->response};
+            }
+
+            if (!waited)
+            {
+                waited = true;
+                waits.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (!entry->finished.wait_until(lock, deadline, [&]
+                                            { return entry->state != Entry::State::InFlight; }))
+            {
+                return {Outcome::InProgress, nullptr, {}};
+            }
+            // Done: replay it on the next pass. Abandoned: the key is free to claim.
+        }
+    }
+
+    // Stores the owner's response and releases any duplicates waiting on it
+    void complete(const std::string &key, const std::shared_ptr<Entry> &entry, StoredResponse response,
+                  int64_t now = nowSeconds())
+    {
+        Shard &shard = shardFor(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            entry->response = std::move(response);
+            entry->expiresAt = expiryFrom(now);
+            entry->state = Entry::State::Done;
+        }
+        entry->finished.notify_all();
+    }
+
+    // The owner gave up without a result worth replaying (5xx, 429); the next
+    // request with this key runs again
+    void abandon(const std::string &key, const std::shared_ptr<Entry> &entry)
+    {
+        Shard &shard = shardFor(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            entry->state = Entry::State::Abandoned;
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end() && it->second == entry)
+            {
+                shard.entries.erase(it);
+            }
+        }
+        entry->finished.notify_all();
+    }
+
+    uint64_t replayed() const { return replays.load(std::memory_order_relaxed); }
+    uint64_t waited() const { return waits.load(std::memory_order_relaxed); }
+
+    size_t size()
+    {
+        size_t total = 0;
+        for (auto &shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.entries.size();
+        }
+        return total;
+    }
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Appends `text` to `out` as the contents of a JSON string literal (no quotes).
+inline void appendJsonEscaped(std::string &out, std::string_view text)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                out += "\\u00";
+                out += hex[(c >> 4) & 0x0f];
+                out += hex[c & 0x0f];
+            }
+            else
+            {
+                out += c;
+            }
+        }
+    }
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "json_writer.h"
+#include "rolling_file.h"
+
+enum class LogLevel : int
+{
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3,
+    Off = 4
+};
+
+// Records below this level compile to nothing. Set from CMake (FLIGHT_LOG_COMPILED_LEVEL).
+#ifndef FLIGHT_LOG_COMPILED_LEVEL
+#define FLIGHT_LOG_COMPILED_LEVEL 0
+#endif
+
+inline const char *logLevelName(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Debug:
+        return "debug";
+    case LogLevel::Info:
+        return "info";
+    case LogLevel::Warn:
+        return "warn";
+    case LogLevel::Error:
+        return "error";
+    default:
+        return "off";
+    }
+}
+
+inline LogLevel parseLogLevel(const std::string &name, LogLevel fallback)
+{
+    for (LogLevel level : {LogLevel::Debug, LogLevel::Info, LogLevel::Warn, LogLevel::Error, LogLevel::Off})
+    {
+        if (name == logLevelName(level))
+        {
+            return level;
+        }
+    }
+    return fallback;
+}
+
+struct LoggerOptions
+{
+    LogLevel level = LogLevel::Info;
+    std::string path = "logs/flight.log";
+    size_t maxFileBytes = 10 * 1024 * 1024;
+    int maxFiles = 5; // rotated files kept besides the live one; 0 truncates it in place
+};
+
+// Fixed-size so producers format straight into a ring slot without allocating.
+struct LogRecord
+{
+    int64_t timestampUs;
+    LogLevel level;
+    uint32_t thread;
+    char component[24];
+    char message[216];
+};
+
+// Bounded multi-producer queue (Vyukov's sequence-numbered ring). Producers claim a
+// slot with one CAS and never block; a single consumer drains in order.
+template <size_t Capacity>
+class LogRing
+{
+private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) size_t dequeuePos = 0;
+
+public:
+    LogRing() : cells(new Cell[Capacity])
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Calls fill(record) on a claimed slot. Returns false when the ring is full.
+    template <typename Fill>
+    bool tryPush(Fill &&fill)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &cells[pos & (Capacity - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        fill(cell->record);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Single consumer only: whether tryPop() would find a record
+    bool pending() const
+    {
+        const Cell &cell = cells[dequeuePos & (Capacity - 1)];
+        return static_cast<intptr_t>(cell.sequence.load(std::memory_order_acquire)) -
+                   static_cast<intptr_t>(dequeuePos + 1) >=
+               0;
+    }
+
+    // Single consumer only.
+    template <typename Consume>
+    bool tryPop(Consume &&consume)
+    {
+        Cell *cell = &cells[dequeuePos & (Capacity - 1)];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(dequeuePos + 1) < 0)
+        {
+            return false;
+        }
+        consume(cell->record);
+        cell->sequence.store(dequeuePos + Capacity, std::memory_order_release);
+        ++dequeuePos;
+        return true;
+    }
+};
+
+// Asynchronous structured logger. Handler threads enqueue records; a background
+// thread writes them as JSON lines to a size-rotated file, one write and flush per
+// drained batch. When the ring is empty the writer sleeps on a condition variable,
+// and only a producer that finds it asleep takes the mutex to wake it. When the
+// ring is full the record is counted as dropped instead of blocking the caller.
+class Logger
+{
+private:
+    LogRing<8192> ring;
+    std::atomic<int> minLevel{static_cast<int>(LogLevel::Info)};
+    std::atomic<uint64_t> droppedRecords{0};
+    std::atomic<uint32_t> nextThreadId{1};
+    std::atomic<bool> running{false};
+    std::atomic<bool> sleeping{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread writer;
+    LoggerOptions options;
+    RollingFile file;
+
+    uint32_t threadId()
+    {
+        thread_local uint32_t id = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+
+    static void formatRecord(const LogRecord &record, std::string &line)
+    {
+        time_t seconds = static_cast<time_t>(record.timestampUs / 1000000);
+        std::tm utc{};
+#ifdef _WIN32
+        gmtime_s(&utc, &seconds);
+#else
+        gmtime_r(&seconds, &utc);
+#endif
+        char timestamp[40];
+        size_t length = std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &utc);
+        std::snprintf(timestamp + length, sizeof(timestamp) - length, ".%06lldZ",
+                      static_cast<long long>(record.timestampUs % 1000000));
+
+        line += R"({"ts":")";
+        line += timestamp;
+        line += R"(","level":")";
+        line += logLevelName(record.level);
+        line += R"(","thread":)";
+        line += std::to_string(record.thread);
+        line += R"(,"component":")";
+        appendJsonEscaped(line, record.component);
+        line += R"(","msg":")";
+        appendJsonEscaped(line, record.message);
+        line += "\"}\n";
+    }
+
+    // Drains whatever is queued; returns false if there was nothing.
+    bool drain(std::string &batch)
+    {
+        batch.clear();
+        while (batch.size() < 64 * 1024 && ring.tryPop([&](const LogRecord &record)
+                                                       { formatRecord(record, batch); }))
+        {
+        }
+        if (batch.empty())
+        {
+            return false;
+        }
+        file.write(batch.data(), batch.size());
+        file.flush();
+        return true;
+    }
+
+    // Blocks until a producer or stop() wakes the writer. The flag is raised
+    // before the ring is checked and producers check it after pushing (each side
+    // behind a full fence), so a record pushed meanwhile is either seen here or
+    // its producer sees the flag and notifies.
+    void sleepUntilWoken()
+    {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ring.pending())
+        {
+            wake.wait(lock, [this]
+                      { return !sleeping.load(std::memory_order_relaxed) || !running.load(std::memory_order_acquire); });
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    void wakeWriter()
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        sleeping.store(false, std::memory_order_relaxed);
+        wake.notify_one();
+    }
+
+    void run()
+    {
+        std::string batch;
+        batch.reserve(64 * 1024 + 1024);
+        while (running.load(std::memory_order_acquire))
+        {
+            if (!drain(batch))
+            {
+                sleepUntilWoken();
+            }
+        }
+        while (drain(batch))
+        {
+        }
+    }
+
+public:
+    static Logger &instance()
+    {
+        static Logger logger;
+        return logger;
+    }
+
+    ~Logger()
+    {
+        stop();
+    }
+
+    void start(const LoggerOptions &loggerOptions)
+    {
+        if (running.exchange(true))
+        {
+            return;
+        }
+        options = loggerOptions;
+        setLevel(options.level);
+        file.open(options.path, options.maxFileBytes, options.maxFiles);
+        writer = std::thread(&Logger::run, this);
+    }
+
+    // Flushes everything queued so far and joins the writer thread.
+    void stop()
+    {
+        if (!running.exchange(false))
+        {
+            return;
+        }
+        wakeWriter();
+        writer.join();
+        file.close();
+    }
+
+    void setLevel(LogLevel level) { minLevel.store(static_cast<int>(level), std::memory_order_relaxed); }
+
+    bool enabled(LogLevel level) const
+    {
+        return static_cast<int>(level) >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    uint64_t dropped() const { return droppedRecords.load(std::memory_order_relaxed); }
+
+#if defined(__GNUC__)
+    __attribute__((format(printf, 4, 5)))
+#endif
+    void log(LogLevel level, const char *component, const char *format, ...)
+    {
+        int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+        uint32_t thread = threadId();
+
+        va_list args;
+        va_start(args, format);
+        bool queued = ring.tryPush([&](LogRecord &record)
+                                   {
+            record.timestampUs = now;
+            record.level = level;
+            record.thread = thread;
+            std::snprintf(record.component, sizeof(record.component), "%s", component);
+            std::vsnprintf(record.message, sizeof(record.message), format, args); });
+        va_end(args);
+
+        if (!queued)
+        {
+            droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed))
+        {
+            wakeWriter();
+        }
+    }
+};
+
+#define FLIGHT_LOG(level, component, ...)                                           \
+    do                                                                              \
+    {                                                                               \
+        if constexpr (static_cast<int>(level) >= FLIGHT_LOG_COMPILED_LEVEL)         \
+        {                                                                           \
+            if (Logger::instance().enabled(level))                                  \
+                Logger::instance().log(level, component, __VA_ARGS__);              \
+        }                                                                           \
+    } while (0)
+
+#define LOG_DEBUG(component, ...) FLIGHT_LOG(LogLevel::Debug, component, __VA_ARGS__)
+#define LOG_INFO(component, ...) FLIGHT_LOG(LogLevel::Info, component, __VA_ARGS__)
+#define LOG_WARN(component, ...) FLIGHT_LOG(LogLevel::Warn, component, __VA_ARGS__)
+#define LOG_ERROR(component, ...) FLIGHT_LOG(LogLevel::Error, component, __VA_ARGS__)
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#if defined(__linux__)
+#include <sys/prctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#endif
+
+struct PreforkOptions
+{
+    int workers = 1;                // worker processes; 1 serves from the main process
+    size_t inventoryFlights = 4096; // flights the shared seat inventory has room for
+    size_t rateLimitKeys = 65536;   // clients the shared rate limit budgets have room for
+};
+
+// "logs/flight.log" -> "logs/flight-w2.log", so workers never share a file
+inline std::string workerPath(const std::string &path, int worker)
+{
+    std::string suffix = "-w" + std::to_string(worker);
+    size_t slash = path.find_last_of("/\\");
+    size_t dot = path.find('.', slash == std::string::npos ? 0 : slash + 1);
+    if (dot == std::string::npos || dot == 0 || (slash != std::string::npos && dot == slash + 1))
+    {
+        return path + suffix;
+    }
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+// First request ID for a worker incarnation: worker index in bits 43-52, restart
+// generation (mod 2048) in bits 32-42 and a 32-bit sequence below, so IDs from
+// different workers, or from a restarted worker, never collide and all stay
+// below 2^53 for JSON consumers.
+inline uint64_t workerFirstRequestId(int worker, int generation)
+{
+    return (static_cast<uint64_t>(worker & 0x3FF) << 43) | (static_cast<uint64_t>(generation & 0x7FF) << 32) | 1;
+}
+
+#if defined(__linux__)
+
+// Forks `workers` processes that each run `workerMain(index, generation)`, where
+// `generation` is 0 on an index's first fork and goes up with each restart, and
+// keeps that many alive: a worker that exits or crashes is reaped, `onWorkerLost(index)` runs (to
+// repair shared state it may have left behind), and the worker is forked again, backing
+// off while it keeps dying straight after start. SIGTERM or SIGINT to the
+// supervisor is passed on to the workers, and run() returns once they have all
+// exited. The supervisor stays single-threaded so that fork() is safe.
+class PreforkSupervisor
+{
+private:
+    struct Worker
+    {
+        pid_t pid = 0;
+        std::chrono::steady_clock::time_point startedAt;
+        int restartDelayMs = 0;
+        int generation = -1; // incremented on every fork
+    };
+
+    static constexpr int pollIntervalMs = 100;
+    static constexpr int minRestartDelayMs = 100;
+    static constexpr int maxRestartDelayMs = 30000;
+
+    int workerCount;
+    std::function<int(int, int)> workerMain;
+    std::function<void(int)> onWorkerLost;
+    std::vector<Worker> workers;
+
+    static volatile std::sig_atomic_t &stopRequested()
+    {
+        static volatile std::sig_atomic_t requested = 0;
+        return requested;
+    }
+
+    static void requestStop(int)
+    {
+        stopRequested() = 1;
+    }
+
+    bool spawn(int index)
+    {
+        pid_t supervisor = getpid();
+        int generation = ++workers[index].generation;
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            std::cerr << "fork failed for worker " << index << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (pid == 0)
+        {
+            std::signal(SIGTERM, SIG_DFL);
+            std::signal(SIGINT, SIG_DFL);
+            // Workers go down with the supervisor rather than holding the port
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() != supervisor)
+            {
+                _exit(1);
+            }
+            _exit(workerMain(index, generation));
+        }
+        workers[index].pid = pid;
+        workers[index].startedAt = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    void signalWorkers(int signal)
+    {
+        for (const Worker &worker : workers)
+        {
+            if (worker.pid > 0)
+            {
+                kill(worker.pid, signal);
+            }
+        }
+    }
+
+    bool anyAlive() const
+    {
+        for (const Worker &worker : workers)
+        {
+            if (worker.pid > 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Sleeps unless a stop is requested meanwhile
+    static void sleepUnlessStopping(int milliseconds)
+    {
+        timespec remaining{milliseconds / 1000, (milliseconds % 1000) * 1000000L};
+        while (!stopRequested() && nanosleep(&remaining, &remaining) != 0 && errno == EINTR)
+        {
+        }
+    }
+
+public:
+    PreforkSupervisor(int workers, std::function<int(int, int)> workerMain, std::function<void(int)> onWorkerLost)
+        : workerCount(workers), workerMain(std::move(workerMain)), onWorkerLost(std::move(onWorkerLost)),
+          workers(static_cast<size_t>(workers)) {}
+
+    int run()
+    {
+        struct sigaction action = {};
+        action.sa_handler = &PreforkSupervisor::requestStop;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGINT, &action, nullptr);
+
+        for (int i = 0; i < workerCount; ++i)
+        {
+            if (!spawn(i))
+            {
+                stopRequested() = 1;
+                break;
+            }
+        }
+
+        bool stopping = false;
+        while (anyAlive())
+        {
+            if (stopRequested() && !stopping)
+            {
+                stopping = true;
+                signalWorkers(SIGTERM);
+            }
+
+            // Polled rather than blocking, so a stop request can never be missed
+            // between the check above and the wait
+            int status = 0;
+            pid_t pid = waitpid(-1, &status, WNOHANG);
+            if (pid == 0 || (pid < 0 && errno == EINTR))
+            {
+                sleepUnlessStopping(pollIntervalMs);
+                continue;
+            }
+            if (pid < 0)
+            {
+                break;
+            }
+
+            int index = -1;
+            for (int i = 0; i < workerCount; ++i)
+            {
+                if (workers[i].pid == pid)
+                    index = i;
+            }
+            if (index < 0)
+            {
+                continue;
+            }
+            Worker &worker = workers[index];
+            worker.pid = 0;
+            if (stopping || stopRequested())
+            {
+                continue;
+            }
+
+            if (WIFSIGNALED(status))
+                std::cerr << "Worker " << index << " (pid " << pid << ") killed by signal " << WTERMSIG(status) << std::endl;
+            else
+                std::cerr << "Worker " << index << " (pid " << pid << ") exited with status " << WEXITSTATUS(status) << std::endl;
+
+            onWorkerLost(index);
+
+            // Back off while a worker dies straight after starting (e.g. port in use)
+            auto uptime = std::chrono::steady_clock::now() - worker.startedAt;
+            if (uptime < std::chrono::seconds(1))
+                worker.restartDelayMs = worker.restartDelayMs ? std::min(worker.restartDelayMs * 2, maxRestartDelayMs) : minRestartDelayMs;
+            else
+                worker.restartDelayMs = 0;
+            sleepUnlessStopping(worker.restartDelayMs);
+
+            if (!stopRequested())
+            {
+                spawn(index);
+            }
+        }
+        return 0;
+    }
+};
+
+#endif
@@ -0,0 +1,457 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// Routes that get their own budget. Anything else is not rate limited.
+enum class RouteClass
+{
+    Auth,         // /login, /register: password hashing
+    BookingWrite, // POST/PUT/DELETE under /api/bookings, seat assignment: SQLite writes
+    None
+};
+
+struct RateLimitBudget
+{
+    double ratePerSecond;
+    double burst;
+};
+
+struct RateLimitOptions
+{
+    bool enabled = true;
+    RateLimitBudget auth{1.0, 5.0};
+    RateLimitBudget booking{5.0, 10.0};
+    int64_t idleSeconds = 300; // buckets untouched this long are dropped
+};
+
+struct RateLimitDecision
+{
+    bool allowed;
+    int retryAfterSeconds;
+};
+
+// Budgets shared by the pre-fork workers, so a client spreading requests over
+// several connections still gets one budget rather than one per worker. The
+// table lives in an anonymous MAP_SHARED mapping created before fork(). Each
+// entry holds the full 64-bit fingerprint of a key and its GCRA "theoretical
+// arrival time" in nanoseconds since the mapping was made; a request is one CAS
+// on the arrival time, so no lock is held across processes.
+//
+// An entry whose arrival time has passed has refilled its whole burst, so another
+// key may take it over. The new owner first swaps the arrival time for a claim
+// marker, which fails any CAS still aimed at the old owner's time, then writes
+// its fingerprint and only then its own arrival time. Readers load the arrival
+// time before the fingerprint, so they never charge a time that belongs to a
+// different key. A claim left by a worker that died mid-takeover expires.
+class SharedRateLimits
+{
+public:
+    enum class Outcome
+    {
+        Decided,
+        TableFull // every entry this key may use belongs to a busy key
+    };
+
+private:
+    static constexpr size_t maxProbes = 16;
+    static constexpr int64_t claimTimeoutNs = 1000000000LL;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared budgets need lock-free 64-bit atomics");
+    static_assert(std::atomic<int64_t>::is_always_lock_free, "shared budgets need lock-free 64-bit atomics");
+
+    struct alignas(64) Header
+    {
+        int64_t startNs; // steady clock at create(); CLOCK_MONOTONIC is the same in every worker
+        std::atomic<uint64_t> rejected;
+        std::atomic<uint64_t> tableFull;
+    };
+
+    struct alignas(16) Entry
+    {
+        std::atomic<uint64_t> fingerprint; // 0 while never used
+        std::atomic<int64_t> arrival;      // >= 0: arrival time; < 0: claimMarker() of a takeover
+    };
+
+    void *region = nullptr;
+    size_t regionBytes = 0;
+    Header *header = nullptr;
+    Entry *entries = nullptr;
+    size_t entryCount = 0;
+
+    static int64_t claimMarker(int64_t now) { return -now - 1; }
+
+    // Free for another key: never used, refilled, or abandoned mid-takeover
+    static bool reusable(int64_t arrival, int64_t now)
+    {
+        return arrival >= 0 ? arrival <= now : now - (-arrival - 1) > claimTimeoutNs;
+    }
+
+    // Whether the request fits the budget; if so, `arrival` becomes the new time
+    static bool admit(int64_t &arrival, int64_t now, int64_t interval, int64_t tolerance, RateLimitDecision &decision)
+    {
+        arrival = std::max(arrival, now);
+        if (arrival - now > tolerance)
+        {
+            int64_t waitNs = arrival - tolerance - now;
+            decision = {false, std::max(1, static_cast<int>((waitNs + 999999999) / 1000000000))};
+            return false;
+        }
+        arrival += interval;
+        decision = {true, 0};
+        return true;
+    }
+
+public:
+    SharedRateLimits() = default;
+    SharedRateLimits(const SharedRateLimits &) = delete;
+    SharedRateLimits &operator=(const SharedRateLimits &) = delete;
+
+    ~SharedRateLimits()
+    {
+#if defined(__linux__)
+        if (region)
+        {
+            munmap(region, regionBytes);
+        }
+#endif
+    }
+
+    // Maps room for `keys` client budgets. Must run before fork(); false if
+    // shared memory is unavailable (or not on Linux).
+    bool create(size_t keys, int64_t nowNs)
+    {
+#if defined(__linux__)
+        if (region || keys == 0)
+        {
+            return false;
+        }
+        regionBytes = sizeof(Header) + keys * sizeof(Entry);
+        void *mapping = mmap(nullptr, regionBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            return false;
+        }
+        region = mapping;
+        char *bytes = static_cast<char *>(region);
+        header = new (bytes) Header();
+        header->startNs = nowNs;
+        header->rejected.store(0, std::memory_order_relaxed);
+        header->tableFull.store(0, std::memory_order_relaxed);
+        entries = reinterpret_cast<Entry *>(bytes + sizeof(Header));
+        entryCount = keys;
+        for (size_t i = 0; i < entryCount; ++i)
+        {
+            new (&entries[i]) Entry();
+            entries[i].fingerprint.store(0, std::memory_order_relaxed);
+            entries[i].arrival.store(0, std::memory_order_relaxed);
+        }
+        return true;
+#else
+        (void)keys;
+        (void)nowNs;
+        return false;
+#endif
+    }
+
+    bool active() const { return entries != nullptr; }
+
+    // Charges one request to the key with `fingerprint` (never 0). TableFull
+    // leaves `decision` unset; the caller rejects the request rather than
+    // limiting the key per worker.
+    Outcome acquire(uint64_t fingerprint, const RateLimitBudget &budget, int64_t nowNs, RateLimitDecision &decision)
+    {
+        int64_t now = nowNs - header->startNs;
+        int64_t interval = std::max<int64_t>(1, std::llround(1e9 / budget.ratePerSecond));
+        int64_t tolerance = static_cast<int64_t>((std::max(budget.burst, 1.0) - 1.0) * static_cast<double>(interval));
+
+        for (;;)
+        {
+            Entry *owned = nullptr;
+            Entry *spare = nullptr;
+            int64_t ownedArrival = 0;
+            int64_t spareArrival = 0;
+            bool claimInProgress = false;
+            for (size_t probe = 0; probe < maxProbes && probe < entryCount; ++probe)
+            {
+                Entry &entry = entries[(fingerprint + probe) % entryCount];
+                // Arrival first: see the class comment
+                int64_t arrival = entry.arrival.load(std::memory_order_acquire);
+                uint64_t owner = entry.fingerprint.load(std::memory_order_acquire);
+                if (owner == fingerprint && arrival >= 0)
+                {
+                    owned = &entry;
+                    ownedArrival = arrival;
+                    break;
+                }
+                if (arrival < 0 && !reusable(arrival, now))
+                {
+                    // Possibly this very key being added by another worker
+                    claimInProgress = true;
+                }
+                else if (!spare && reusable(arrival, now))
+                {
+                    spare = &entry;
+                    spareArrival = arrival;
+                }
+            }
+
+            if (owned)
+            {
+                int64_t arrival = ownedArrival;
+                if (!admit(arrival, now, interval, tolerance, decision))
+                {
+                    header->rejected.fetch_add(1, std::memory_order_relaxed);
+                    return Outcome::Decided;
+                }
+                if (owned->arrival.compare_exchange_weak(ownedArrival, arrival, std::memory_order_acq_rel))
+                {
+                    return Outcome::Decided;
+                }
+                continue; // another worker charged this key (or took the entry) first
+            }
+            if (claimInProgress)
+            {
+                // Taking a later entry now could give this key two budgets
+                std::this_thread::yield();
+                continue;
+            }
+            if (!spare)
+            {
+                header->tableFull.fetch_add(1, std::memory_order_relaxed);
+                return Outcome::TableFull;
+            }
+            if (!spare->arrival.compare_exchange_strong(spareArrival, claimMarker(now), std::memory_order_acq_rel))
+            {
+                continue;
+            }
+            spare->fingerprint.store(fingerprint, std::memory_order_release);
+            int64_t arrival = now;
+            admit(arrival, now, interval, tolerance, decision); // a refilled budget always admits
+            spare->arrival.store(arrival, std::memory_order_release);
+            return Outcome::Decided;
+        }
+    }
+
+    uint64_t rejectedRequests() const
+    {
+        return header ? header->rejected.load(std::memory_order_relaxed) : 0;
+    }
+
+    // Requests turned away because the table had no room for their key
+    uint64_t tableFullRejections() const
+    {
+        return header ? header->tableFull.load(std::memory_order_relaxed) : 0;
+    }
+
+    // Keys still short of their full burst
+    size_t busyEntries(int64_t nowNs) const
+    {
+        if (!entries)
+        {
+            return 0;
+        }
+        int64_t now = nowNs - header->startNs;
+        size_t count = 0;
+        for (size_t i = 0; i < entryCount; ++i)
+        {
+            count += entries[i].arrival.load(std::memory_order_relaxed) > now;
+        }
+        return count;
+    }
+};
+
+class RateLimiter
+{
+private:
+    static constexpr size_t shardCount = 64;
+    static constexpr size_t routeClassCount = static_cast<size_t>(RouteClass::None);
+    static constexpr int64_t maxSweepIntervalNs = 60 * 1000000000LL;
+
+    struct Bucket
+    {
+        double tokens;
+        int64_t lastNs;
+    };
+
+    // Each shard sits on its own cache line so threads hashing to different
+    // shards never contend on the same mutex or line.
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, Bucket> buckets[routeClassCount];
+    };
+
+    RateLimitOptions options;
+    int64_t sweepIntervalNs;
+    Shard shards[shardCount];
+    std::atomic<int64_t> nextSweepNs{0};
+    std::atomic<uint64_t> rejected{0};
+    SharedRateLimits *shared = nullptr; // budgets common to all pre-fork workers
+
+    const RateLimitBudget &budgetFor(RouteClass routeClass) const
+    {
+        return routeClass == RouteClass::Auth ? options.auth : options.booking;
+    }
+
+    // An idle bucket has refilled to its burst, so dropping it loses nothing.
+    // Runs over every shard once per interval, whichever shard the triggering
+    // request hashed to, so keys that went quiet are freed even when no new
+    // traffic lands on their shard.
+    void sweepIfDue(int64_t nowNs)
+    {
+        int64_t due = nextSweepNs.load(std::memory_order_relaxed);
+        if (nowNs < due ||
+            !nextSweepNs.compare_exchange_strong(due, nowNs + sweepIntervalNs, std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        int64_t cutoff = nowNs - options.idleSeconds * 1000000000LL;
+        for (auto &shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto &buckets : shard.buckets)
+            {
+                for (auto it = buckets.begin(); it != buckets.end();)
+                {
+                    if (it->second.lastNs < cutoff)
+                        it = buckets.erase(it);
+                    else
+                        ++it;
+                }
+            }
+        }
+    }
+
+public:
+    explicit RateLimiter(const RateLimitOptions &options = {})
+        : options(options),
+          sweepIntervalNs(std::max<int64_t>(1, std::min<int64_t>(options.idleSeconds * 1000000000LL, maxSweepIntervalNs))) {}
+
+    // Keeps budgets in `table` from now on, so they hold across worker processes.
+    // A request whose key finds no room in the table is rejected: limiting it per
+    // process instead would give it one budget per worker.
+    void share(SharedRateLimits *table)
+    {
+        shared = table && table->active() ? table : nullptr;
+    }
+
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static RouteClass classify(const std::string &method, const std::string &path)
+    {
+        if (method == "POST" && (path == "/login" || path == "/register"))
+        {
+            return RouteClass::Auth;
+        }
+        bool bookingsPath = path.compare(0, 13, "/api/bookings") == 0 && (path.size() == 13 || path[13] == '/');
+        if (bookingsPath && (method == "POST" || method == "PUT" || method == "DELETE"))
+        {
+            return RouteClass::BookingWrite;
+        }
+        if (method == "POST" && path.compare(0, 13, "/api/flights/") == 0 &&
+            path.size() > 7 && path.compare(path.size() - 7, 7, "/assign") == 0)
+        {
+            return RouteClass::BookingWrite;
+        }
+        return RouteClass::None;
+    }
+
+    // Takes one token from the bucket for `key` (a client IP or "acct:<email>").
+    RateLimitDecision acquire(RouteClass routeClass, const std::string &key, int64_t now = nowNs())
+    {
+        if (!options.enabled || routeClass == RouteClass::None)
+        {
+            return {true, 0};
+        }
+
+        const RateLimitBudget &budget = budgetFor(routeClass);
+        size_t hash = std::hash<std::string>{}(key);
+
+        if (shared)
+        {
+            // The route class gives the same client a different fingerprint
+            uint64_t fingerprint = (static_cast<uint64_t>(hash) ^ static_cast<uint64_t>(routeClass)) * 0x9E3779B97F4A7C15ULL;
+            RateLimitDecision decision;
+            if (shared->acquire(fingerprint ? fingerprint : 1, budget, now, decision) == SharedRateLimits::Outcome::TableFull)
+            {
+                return {false, 1};
+            }
+            return decision;
+        }
+
+        Shard &shard = shards[hash % shardCount];
+
+        sweepIfDue(now);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto &buckets = shard.buckets[static_cast<size_t>(routeClass)];
+        auto it = buckets.find(key);
+        if (it == buckets.end())
+        {
+            buckets.emplace(key, Bucket{budget.burst - 1.0, now});
+            return {true, 0};
+        }
+
+        Bucket &bucket = it->second;
+        double elapsed = static_cast<double>(now - bucket.lastNs) / 1e9;
+        bucket.tokens = std::min(budget.burst, bucket.tokens + elapsed * budget.ratePerSecond);
+        bucket.lastNs = now;
+
+        if (bucket.tokens >= 1.0)
+        {
+            bucket.tokens -= 1.0;
+            return {true, 0};
+        }
+
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        double wait = (1.0 - bucket.tokens) / budget.ratePerSecond;
+        return {false, std::max(1, static_cast<int>(std::ceil(wait)))};
+    }
+
+    uint64_t rejectedRequests() const
+    {
+        uint64_t total = rejected.load(std::memory_order_relaxed);
+        return shared ? total + shared->rejectedRequests() : total;
+    }
+
+    // Requests rejected because the shared table was full; see share()
+    uint64_t tableFullRejections() const
+    {
+        return shared ? shared->tableFullRejections() : 0;
+    }
+
+    size_t trackedBuckets()
+    {
+        size_t total = shared ? shared->busyEntries(nowNs()) : 0;
+        for (auto &shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto &buckets : shard.buckets)
+            {
+                total += buckets.size();
+            }
+        }
+        return total;
+    }
+};
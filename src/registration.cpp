@@ -10,6 +10,19 @@
 #include <ctime>
 #include <sstream>
 #include <filesystem>
+#include <map>
+#include <mutex>
+
+#include "analytics.h"
+#include "idempotency.h"
+#include "logger.h"
+#include "prefork.h"
+#include "request_codec.h"
+#include "router.h"
+#include "seat_inventory.h"
+#include "seat_map.h"
+#include "server_config.h"
+#include "tracing.h"
 
 using namespace std;
 using json = nlohmann::json;
@@ -78,16 +91,24 @@ public:
         {
             throw std::runtime_error("Can't open database: " + std::string(sqlite3_errmsg(db)));
         }
+        // Pre-fork workers share the file; wait for another process's write instead of failing
+        sqlite3_busy_timeout(db, 5000);
         initDatabase();
     }
 
+    // Lets readers in other worker processes run alongside a writer
+    void useWriteAheadLog()
+    {
+        sqlite3_exec(db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+    }
+
     bool registerUser(const std::string &name, const std::string &email, const std::string &password)
     {
         try
         {
             if (name.empty() || email.empty() || password.empty())
             {
-                std::cout << "Error: All fields are required\n";
+                LOG_WARN("registration", "Registration rejected: all fields are required");
                 return false;
             }
 
@@ -114,7 +135,7 @@ public:
 
             if (rc == SQLITE_CONSTRAINT)
             {
-                std::cout << "Error: Email already exists\n";
+                LOG_INFO("registration", "Registration rejected: email already exists");
                 return false;
             }
             else if (rc != SQLITE_DONE)
@@ -126,7 +147,7 @@ public:
         }
         catch (const std::exception &e)
         {
-            std::cerr << "Error: " << e.what() << std::endl;
+            LOG_ERROR("registration", "registerUser failed: %s", e.what());
             return false;
         }
     }
@@ -165,7 +186,7 @@ public:
         }
         catch (const std::exception &e)
         {
-            std::cerr << "Error: " << e.what() << std::endl;
+            LOG_ERROR("registration", "loginUser failed: %s", e.what());
             return false;
         }
     }
@@ -179,10 +200,79 @@ public:
     }
 };
 
+// A booking as it was before a status change, read in the same transaction as
+// the update, and whether the update changed it
+struct BookingTransition
+{
+    bool found = false;
+    bool changed = false;
+    int flightId = 0;
+    int seatNumber = 0;
+    string previousStatus;
+};
+
 class Database
 {
 private:
     sqlite3 *db;
+    // All handler threads share one connection, so reads and writes (and the
+    // transaction in bookSeats) are serialised here. A reader that ran while a
+    // writer held BEGIN IMMEDIATE would see its uncommitted rows.
+    std::mutex connectionMutex;
+
+    std::unique_lock<std::mutex> lockConnection()
+    {
+        TraceSpan span("db.lock_wait");
+        return std::unique_lock<std::mutex>(connectionMutex);
+    }
+
+    int prepare(const string &sql, sqlite3_stmt **stmt)
+    {
+        TraceSpan span("sqlite.prepare");
+        return sqlite3_prepare_v2(db, sql.c_str(), -1, stmt, 0);
+    }
+
+    int step(sqlite3_stmt *stmt)
+    {
+        TraceSpan span("sqlite.step");
+        return sqlite3_step(stmt);
+    }
+
+    // Reads a booking and runs `update` on it in one transaction, so concurrent
+    // changes to the same booking (from this process or another worker) each
+    // see the state the previous one left
+    template <typename Bind>
+    bool transitionBooking(int bookingId, const char *update, Bind bind, BookingTransition &transition)
+    {
+        auto lock = lockConnection();
+        transition = BookingTransition();
+
+        if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, 0) != SQLITE_OK)
+        {
+            return false;
+        }
+        transition.found = readBooking(bookingId, transition.flightId, transition.previousStatus,
+                                       &transition.seatNumber);
+        if (!transition.found)
+        {
+            sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+            return false;
+        }
+
+        sqlite3_stmt *stmt;
+        if (prepare(update, &stmt) != SQLITE_OK)
+        {
+            sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+            return false;
+        }
+        bind(stmt);
+        int rc = step(stmt);
+        sqlite3_finalize(stmt);
+        transition.changed = rc == SQLITE_DONE && sqlite3_changes(db) == 1;
+
+        sqlite3_exec(db, rc == SQLITE_DONE ? "COMMIT;" : "ROLLBACK;", 0, 0, 0);
+        return rc == SQLITE_DONE;
+    }
 
 public:
     Database()
@@ -190,18 +280,25 @@ public:
         int rc = sqlite3_open("flights.db", &db);
         if (rc)
         {
-            cerr << "Can't open database: " << sqlite3_errmsg(db) << endl;
+            LOG_ERROR("database", "Can't open database: %s", sqlite3_errmsg(db));
             return;
         }
         else
         {
-            cout << "Database opened successfully.\n"
-                 << flush;
+            LOG_INFO("database", "Database opened successfully");
         }
+        // Pre-fork workers share the file; wait for another process's write instead of failing
+        sqlite3_busy_timeout(db, 5000);
 
         initializeTables();
     }
 
+    // Lets readers in other worker processes run alongside a writer
+    void useWriteAheadLog()
+    {
+        sqlite3_exec(db, "PRAGMA journal_mode=WAL;", 0, 0, 0);
+    }
+
     ~Database()
     {
         sqlite3_close(db);
@@ -230,31 +327,64 @@ public:
             "status TEXT NOT NULL,"
             "FOREIGN KEY(flight_id) REFERENCES flights(flight_id));";
 
+        const char *seat_layouts_sql =
+            "CREATE TABLE IF NOT EXISTS seat_layouts ("
+            "flight_id INTEGER PRIMARY KEY,"
+            "rows INTEGER NOT NULL,"
+            "seat_letters TEXT NOT NULL,"
+            "class_zones TEXT NOT NULL,"
+            "FOREIGN KEY(flight_id) REFERENCES flights(flight_id));";
+
+        const char *idempotency_keys_sql =
+            "CREATE TABLE IF NOT EXISTS idempotency_keys ("
+            "idempotency_key TEXT PRIMARY KEY,"
+            "fingerprint INTEGER NOT NULL,"
+            "status INTEGER NOT NULL,"
+            "response_body TEXT NOT NULL,"
+            "expires_at INTEGER NOT NULL);";
+
         char *errMsg = 0;
         int rc = sqlite3_exec(db, flights_sql, 0, 0, &errMsg);
         if (rc != SQLITE_OK)
         {
-            cerr << "SQL error: " << errMsg << endl;
+            LOG_ERROR("database", "SQL error creating flights: %s", errMsg);
             sqlite3_free(errMsg);
         }
 
         rc = sqlite3_exec(db, bookings_sql, 0, 0, &errMsg);
         if (rc != SQLITE_OK)
         {
-            cerr << "SQL error: " << errMsg << endl;
+            LOG_ERROR("database", "SQL error creating bookings: %s", errMsg);
+            sqlite3_free(errMsg);
+        }
+
+        rc = sqlite3_exec(db, seat_layouts_sql, 0, 0, &errMsg);
+        if (rc != SQLITE_OK)
+        {
+            LOG_ERROR("database", "SQL error creating seat_layouts: %s", errMsg);
+            sqlite3_free(errMsg);
+        }
+
+        rc = sqlite3_exec(db, idempotency_keys_sql, 0, 0, &errMsg);
+        if (rc != SQLITE_OK)
+        {
+            LOG_ERROR("database", "SQL error creating idempotency_keys: %s", errMsg);
             sqlite3_free(errMsg);
         }
     }
 
     bool addFlight(const string &flightNumber, const string &destination,
                    const string &departureDate, int totalSeats,
-                   const string &classType, double price)
+                   const string &classType, double price, int *flightId = nullptr)
     {
+        TraceSpan span("db.addFlight");
+        auto lock = lockConnection();
+
         string sql = "INSERT INTO flights (flight_number, destination, departure_date, "
                      "total_seats, class_type, price) VALUES (?, ?, ?, ?, ?, ?);";
 
         sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+        int rc = prepare(sql, &stmt);
 
         if (rc != SQLITE_OK)
         {
@@ -268,18 +398,54 @@ public:
         sqlite3_bind_text(stmt, 5, classType.c_str(), -1, SQLITE_STATIC);
         sqlite3_bind_double(stmt, 6, price);
 
-        rc = sqlite3_step(stmt);
+        rc = step(stmt);
         sqlite3_finalize(stmt);
 
-        return rc == SQLITE_DONE;
+        if (rc != SQLITE_DONE)
+        {
+            return false;
+        }
+
+        int newFlightId = static_cast<int>(sqlite3_last_insert_rowid(db));
+        if (flightId)
+        {
+            *flightId = newFlightId;
+        }
+
+        // Record the default cabin layout so it can be edited per flight later
+        SeatLayout layout = SeatLayout::forCapacity(totalSeats, classType);
+        string layoutSql = "INSERT OR REPLACE INTO seat_layouts (flight_id, rows, seat_letters, class_zones) "
+                           "VALUES (?, ?, ?, ?);";
+        string zones = SeatLayout::formatZones(layout.classZones());
+        if (prepare(layoutSql, &stmt) == SQLITE_OK)
+        {
+            sqlite3_bind_int(stmt, 1, newFlightId);
+            sqlite3_bind_int(stmt, 2, layout.rows());
+            sqlite3_bind_text(stmt, 3, layout.letters().c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 4, zones.c_str(), -1, SQLITE_STATIC);
+            step(stmt);
+            sqlite3_finalize(stmt);
+        }
+        return true;
     }
 
     bool bookSeat(int flightId, const string &passengerName,
                   const string &passengerEmail, int seatNumber)
     {
+        TraceSpan span("db.bookSeat");
+        auto lock = lockConnection();
+
+        // The check and insert form one transaction so another worker process
+        // cannot book the seat in between
+        if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, 0) != SQLITE_OK)
+        {
+            return false;
+        }
+
         // First check if seat is available
         if (!isSeatAvailable(flightId, seatNumber))
         {
+            sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
             return false;
         }
 
@@ -291,10 +457,11 @@ public:
                      "seat_number, booking_date, status) VALUES (?, ?, ?, ?, ?, 'CONFIRMED');";
 
         sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+        int rc = prepare(sql, &stmt);
 
         if (rc != SQLITE_OK)
         {
+            sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
             return false;
         }
 
@@ -304,55 +471,370 @@ public:
         sqlite3_bind_int(stmt, 4, seatNumber);
         sqlite3_bind_text(stmt, 5, bookingDate.c_str(), -1, SQLITE_STATIC);
 
-        rc = sqlite3_step(stmt);
+        rc = step(stmt);
         sqlite3_finalize(stmt);
 
+        sqlite3_exec(db, rc == SQLITE_DONE ? "COMMIT;" : "ROLLBACK;", 0, 0, 0);
         return rc == SQLITE_DONE;
     }
 
-    bool rescheduleBooking(int bookingId, int newFlightId, const string &newDate)
+    // Moves a booking to another flight as RESCHEDULED, whatever its old status
+    bool rescheduleBooking(int bookingId, int newFlightId, const string &newDate, BookingTransition &transition)
+    {
+        TraceSpan span("db.rescheduleBooking");
+        return transitionBooking(bookingId,
+                                 "UPDATE bookings SET flight_id = ?, status = 'RESCHEDULED' WHERE booking_id = ?;",
+                                 [&](sqlite3_stmt *stmt)
+                                 {
+                                     sqlite3_bind_int(stmt, 1, newFlightId);
+                                     sqlite3_bind_int(stmt, 2, bookingId);
+                                 },
+                                 transition);
+    }
+
+    // Cancels a booking; `transition.changed` is false if it was already cancelled
+    bool cancelBooking(int bookingId, BookingTransition &transition)
+    {
+        TraceSpan span("db.cancelBooking");
+        return transitionBooking(bookingId,
+                                 "UPDATE bookings SET status = 'CANCELLED' "
+                                 "WHERE booking_id = ? AND status != 'CANCELLED';",
+                                 [&](sqlite3_stmt *stmt)
+                                 { sqlite3_bind_int(stmt, 1, bookingId); },
+                                 transition);
+    }
+
+    // Books every seat in `seatNumbers` for one passenger, or none of them
+    bool bookSeats(int flightId, const string &passengerName,
+                   const string &passengerEmail, const vector<int> &seatNumbers)
     {
-        string sql = "UPDATE bookings SET flight_id = ?, status = 'RESCHEDULED' "
-                     "WHERE booking_id = ?;";
+        TraceSpan span("db.bookSeats");
+        auto lock = lockConnection();
+
+        if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, 0) != SQLITE_OK)
+        {
+            return false;
+        }
+
+        time_t now = time(0);
+        string bookingDate = ctime(&now);
+        bookingDate = bookingDate.substr(0, bookingDate.length() - 1); // Remove newline
+
+        string sql = "INSERT INTO bookings (flight_id, passenger_name, passenger_email, "
+                     "seat_number, booking_date, status) VALUES (?, ?, ?, ?, ?, 'CONFIRMED');";
 
         sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+        bool ok = prepare(sql, &stmt) == SQLITE_OK;
+        for (size_t i = 0; ok && i < seatNumbers.size(); ++i)
+        {
+            if (!isSeatAvailable(flightId, seatNumbers[i]))
+            {
+                ok = false;
+                break;
+            }
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, flightId);
+            sqlite3_bind_text(stmt, 2, passengerName.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 3, passengerEmail.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int(stmt, 4, seatNumbers[i]);
+            sqlite3_bind_text(stmt, 5, bookingDate.c_str(), -1, SQLITE_STATIC);
+            ok = step(stmt) == SQLITE_DONE;
+        }
+        sqlite3_finalize(stmt);
 
-        if (rc != SQLITE_OK)
+        sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", 0, 0, 0);
+        return ok;
+    }
+
+    // Cabin layout of a flight: the seat_layouts row if there is one, otherwise the
+    // default for its capacity. False if the flight does not exist.
+    bool getSeatLayout(int flightId, SeatLayout &layout)
+    {
+        TraceSpan span("db.getSeatLayout");
+        auto lock = lockConnection();
+
+        string sql = "SELECT f.total_seats, f.class_type, l.rows, l.seat_letters, l.class_zones "
+                     "FROM flights f LEFT JOIN seat_layouts l ON l.flight_id = f.flight_id "
+                     "WHERE f.flight_id = ?;";
+
+        sqlite3_stmt *stmt;
+        if (prepare(sql, &stmt) != SQLITE_OK)
         {
             return false;
         }
+        sqlite3_bind_int(stmt, 1, flightId);
+
+        bool found = step(stmt) == SQLITE_ROW;
+        bool stored = false;
+        int totalSeats = 0, rows = 0;
+        string classType, letters, zones;
+        if (found)
+        {
+            totalSeats = sqlite3_column_int(stmt, 0);
+            classType = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+            stored = sqlite3_column_type(stmt, 2) != SQLITE_NULL;
+            if (stored)
+            {
+                rows = sqlite3_column_int(stmt, 2);
+                letters = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+                zones = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        // Built after the statement is finalized, as a stored layout too wide to
+        // seat throws
+        if (found)
+        {
+            layout = stored ? SeatLayout(rows, totalSeats, letters, SeatLayout::parseZones(zones))
+                            : SeatLayout::forCapacity(totalSeats, classType);
+        }
+        return found;
+    }
+
+    vector<int> getTakenSeats(int flightId)
+    {
+        TraceSpan span("db.getTakenSeats");
+        auto lock = lockConnection();
+
+        vector<int> seats;
+        string sql = "SELECT seat_number FROM bookings WHERE flight_id = ? "
+                     "AND status = 'CONFIRMED';";
+
+        sqlite3_stmt *stmt;
+        if (prepare(sql, &stmt) != SQLITE_OK)
+        {
+            return seats;
+        }
+        sqlite3_bind_int(stmt, 1, flightId);
 
-        sqlite3_bind_int(stmt, 1, newFlightId);
-        sqlite3_bind_int(stmt, 2, bookingId);
+        TraceSpan fetch("sqlite.fetch");
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            seats.push_back(sqlite3_column_int(stmt, 0));
+        }
 
-        rc = sqlite3_step(stmt);
         sqlite3_finalize(stmt);
+        return seats;
+    }
 
-        return rc == SQLITE_DONE;
+    // Current flight and status of a booking; false if it does not exist
+    bool findBooking(int bookingId, int &flightId, string &status, int *seatNumber = nullptr)
+    {
+        TraceSpan span("db.findBooking");
+        auto lock = lockConnection();
+        return readBooking(bookingId, flightId, status, seatNumber);
+    }
+
+    // Claims an Idempotency-Key for a request about to run by writing a pending
+    // row (status 0) that lapses at `leaseUntil`, unless an unexpired row is
+    // already there; then reports its fingerprint and, once it is finished, its
+    // response. The claim is one upsert, atomic across worker processes without
+    // an explicit transaction, so the common case costs a single write.
+    TableClaim claimIdempotencyKey(const string &key, uint64_t fingerprint, int64_t now, int64_t leaseUntil,
+                                   uint64_t &storedFingerprint, StoredResponse &response)
+    {
+        TraceSpan span("db.claimIdempotencyKey");
+        auto lock = lockConnection();
+
+        // Anything unreadable is reported as pending, so the request waits and
+        // retries rather than risking a second run
+        storedFingerprint = fingerprint;
+
+        sqlite3_stmt *stmt;
+        if (prepare("INSERT INTO idempotency_keys "
+                    "(idempotency_key, fingerprint, status, response_body, expires_at) VALUES (?, ?, 0, '', ?) "
+                    "ON CONFLICT(idempotency_key) DO UPDATE SET fingerprint = excluded.fingerprint, "
+                    "status = 0, response_body = '', expires_at = excluded.expires_at "
+                    "WHERE idempotency_keys.expires_at <= ?;",
+                    &stmt) != SQLITE_OK)
+        {
+            return TableClaim::Pending;
+        }
+        sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(fingerprint));
+        sqlite3_bind_int64(stmt, 3, leaseUntil);
+        sqlite3_bind_int64(stmt, 4, now);
+        int rc = step(stmt);
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            return TableClaim::Pending;
+        }
+        if (sqlite3_changes(db) == 1)
+        {
+            return TableClaim::Claimed;
+        }
+
+        // A live row was there; it may have finished or been dropped since
+        if (prepare("SELECT fingerprint, status, response_body FROM idempotency_keys "
+                    "WHERE idempotency_key = ? AND expires_at > ?;",
+                    &stmt) != SQLITE_OK)
+        {
+            return TableClaim::Pending;
+        }
+        sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, now);
+        TableClaim claim = TableClaim::Pending;
+        if (step(stmt) == SQLITE_ROW)
+        {
+            storedFingerprint = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+            response.status = sqlite3_column_int(stmt, 1);
+            response.body = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+            claim = response.status == 0 ? TableClaim::Pending : TableClaim::Stored;
+        }
+        sqlite3_finalize(stmt);
+        return claim;
+    }
+
+    // Drops a pending claim whose request gave up, so the key can run again
+    void abandonIdempotencyKey(const string &key)
+    {
+        TraceSpan span("db.abandonIdempotencyKey");
+        auto lock = lockConnection();
+
+        sqlite3_stmt *stmt;
+        if (prepare("DELETE FROM idempotency_keys WHERE idempotency_key = ? AND status = 0;", &stmt) != SQLITE_OK)
+        {
+            return;
+        }
+        sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+        step(stmt);
+        sqlite3_finalize(stmt);
     }
 
-    bool cancelBooking(int bookingId) {
-    string sql = "UPDATE bookings SET status = 'CANCELLED' WHERE booking_id = ?;";
+    void saveIdempotencyKey(const string &key, uint64_t fingerprint, const StoredResponse &response, int64_t expiresAt)
+    {
+        TraceSpan span("db.saveIdempotencyKey");
+        auto lock = lockConnection();
+
+        string sql = "INSERT OR REPLACE INTO idempotency_keys "
+                     "(idempotency_key, fingerprint, status, response_body, expires_at) VALUES (?, ?, ?, ?, ?);";
+
+        sqlite3_stmt *stmt;
+        if (prepare(sql, &stmt) != SQLITE_OK)
+        {
+            return;
+        }
+        sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(fingerprint));
+        sqlite3_bind_int(stmt, 3, response.status);
+        sqlite3_bind_text(stmt, 4, response.body.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 5, expiresAt);
+        step(stmt);
+        sqlite3_finalize(stmt);
+    }
 
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+    // Drops expired keys, and with `pendingClaims` also the pending claims of
+    // requests that died with an earlier process. Only safe for pending claims
+    // while no other process is serving.
+    void purgeIdempotencyKeys(int64_t now, bool pendingClaims = false)
+    {
+        auto lock = lockConnection();
 
-    if (rc != SQLITE_OK) {
-        return false;
+        sqlite3_stmt *stmt;
+        if (prepare(pendingClaims ? "DELETE FROM idempotency_keys WHERE expires_at <= ? OR status = 0;"
+                                  : "DELETE FROM idempotency_keys WHERE expires_at <= ?;",
+                    &stmt) != SQLITE_OK)
+        {
+            return;
+        }
+        sqlite3_bind_int64(stmt, 1, now);
+        step(stmt);
+        sqlite3_finalize(stmt);
     }
 
-    sqlite3_bind_int(stmt, 1, bookingId);
+    // Fills the shared seat inventory with every flight, its CONFIRMED seats and
+    // the analytics counters, replacing whatever it held. This and loadAnalytics
+    // are the only full scans of the bookings table.
+    void loadSeatInventory(SeatInventory &inventory)
+    {
+        TraceSpan span("db.loadSeatInventory");
+        auto lock = lockConnection();
+
+        std::map<int, std::pair<int, double>> flights; // seat count and price
+        std::map<int, vector<int>> takenSeats;
+        std::map<int, int> activeBookings;
+        std::map<int32_t, int32_t> dayBookings;
+        sqlite3_stmt *stmt;
+        if (prepare("SELECT flight_id, total_seats, price FROM flights;", &stmt) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                flights[sqlite3_column_int(stmt, 0)] = {sqlite3_column_int(stmt, 1), sqlite3_column_double(stmt, 2)};
+            }
+            sqlite3_finalize(stmt);
+        }
+        if (prepare("SELECT flight_id, seat_number, status, booking_date FROM bookings;", &stmt) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                int flightId = sqlite3_column_int(stmt, 0);
+                string status = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+                if (status == "CONFIRMED")
+                {
+                    takenSeats[flightId].push_back(sqlite3_column_int(stmt, 1));
+                }
+                if (status != "CANCELLED")
+                {
+                    ++activeBookings[flightId];
+                }
+                ++dayBookings[BookingAnalytics::dayNumber(BookingAnalytics::dayKeyFromCtime(
+                    reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3))))];
+            }
+            sqlite3_finalize(stmt);
+        }
 
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+        for (const auto &[flightId, flight] : flights)
+        {
+            if (!inventory.addFlight(flightId, flight.first, flight.second))
+            {
+                LOG_WARN("database", "Seat inventory is full; flight %d is served from SQLite only "
+                                     "and left out of analytics", flightId);
+                continue;
+            }
+            inventory.reset(flightId, takenSeats[flightId]);
+        }
+        inventory.resetCounters(vector<std::pair<int, int>>(activeBookings.begin(), activeBookings.end()),
+                                vector<std::pair<int32_t, int32_t>>(dayBookings.begin(), dayBookings.end()));
+        inventory.noteBookingChange();
+    }
 
-    return rc == SQLITE_DONE;
-}
+    // Details of every flight for the analytics, without any counts
+    void loadAnalyticsFlights(BookingAnalytics &analytics)
+    {
+        auto lock = lockConnection();
+        readAnalyticsFlights(analytics);
+    }
+
+    // One-time rebuild of the analytics aggregates from the flights and bookings
+    // tables, for a server that is not sharing counters with other workers
+    void loadAnalytics(BookingAnalytics &analytics)
+    {
+        auto lock = lockConnection();
+        analytics.clear();
+        readAnalyticsFlights(analytics);
+
+        sqlite3_stmt *stmt;
+        if (prepare("SELECT flight_id, booking_date, status FROM bookings;", &stmt) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                string status = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+                analytics.bookingAdded(sqlite3_column_int(stmt, 0),
+                                       BookingAnalytics::dayKeyFromCtime(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1))),
+                                       status != "CANCELLED");
+            }
+            sqlite3_finalize(stmt);
+        }
+    }
 
     // Add this method to the Database class
     vector<json> getBookedFlights(const string &email = "")
     {
+        TraceSpan span("db.getBookedFlights");
+        auto lock = lockConnection();
+
         vector<json> bookings;
         string sql;
 
@@ -378,13 +860,14 @@ public:
         }
 
         sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+        int rc = prepare(sql, &stmt);
 
         if (!email.empty())
         {
             sqlite3_bind_text(stmt, 1, email.c_str(), -1, SQLITE_STATIC);
         }
 
+        TraceSpan fetch("sqlite.fetch");
         while (sqlite3_step(stmt) == SQLITE_ROW)
         {
             json booking = {
@@ -406,8 +889,59 @@ public:
         return bookings;
     }
 
+    // Appends up to `limit` bookings (any status) with IDs above `afterId` to `out`
+    // as JSON objects in ID order, and moves `afterId` past them. Every object but
+    // the export's first (afterId 0) is preceded by a comma, so successive pages
+    // join into one array. Returns how many were written; fewer than `limit`
+    // means there are no more.
+    int exportBookings(int &afterId, int limit, string &out)
+    {
+        TraceSpan span("db.exportBookings");
+        auto lock = lockConnection();
+
+        sqlite3_stmt *stmt;
+        if (prepare("SELECT b.booking_id, b.flight_id, b.passenger_name, b.passenger_email, "
+                    "b.seat_number, b.booking_date, b.status, f.flight_number "
+                    "FROM bookings b JOIN flights f ON b.flight_id = f.flight_id "
+                    "WHERE b.booking_id > ? ORDER BY b.booking_id LIMIT ?;",
+                    &stmt) != SQLITE_OK)
+        {
+            throw std::runtime_error(sqlite3_errmsg(db));
+        }
+        sqlite3_bind_int(stmt, 1, afterId);
+        sqlite3_bind_int(stmt, 2, limit);
+
+        int rows = 0;
+        TraceSpan fetch("sqlite.fetch");
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            json booking = {
+                {"booking_id", sqlite3_column_int(stmt, 0)},
+                {"flight_id", sqlite3_column_int(stmt, 1)},
+                {"passenger_name", reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2))},
+                {"passenger_email", reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3))},
+                {"seat_number", sqlite3_column_int(stmt, 4)},
+                {"booking_date", reinterpret_cast<const char *>(sqlite3_column_text(stmt, 5))},
+                {"status", reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6))},
+                {"flight_number", reinterpret_cast<const char *>(sqlite3_column_text(stmt, 7))}};
+            if (afterId != 0)
+            {
+                out += ',';
+            }
+            out += booking.dump();
+            ++rows;
+            afterId = sqlite3_column_int(stmt, 0);
+        }
+
+        sqlite3_finalize(stmt);
+        return rows;
+    }
+
     vector<json> getAvailableFlights()
     {
+        TraceSpan span("db.getAvailableFlights");
+        auto lock = lockConnection();
+
         vector<json> flights;
         string sql = "SELECT flight_id, flight_number, destination, departure_date, "
                      "class_type, price, total_seats FROM flights WHERE total_seats > "
@@ -415,8 +949,9 @@ public:
                      "AND status = 'CONFIRMED');";
 
         sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+        int rc = prepare(sql, &stmt);
 
+        TraceSpan fetch("sqlite.fetch");
         while (sqlite3_step(stmt) == SQLITE_ROW)
         {
             int flightId = sqlite3_column_int(stmt, 0);
@@ -445,37 +980,41 @@ public:
         return flights;
     }
 
-    int getBookedSeatsCount(int flightId)
+    vector<int> getAvailableSeats(int flightId)
     {
-        string sql = "SELECT COUNT(*) FROM bookings WHERE flight_id = ? AND status = 'CONFIRMED';";
+        TraceSpan span("db.getAvailableSeats");
+        auto lock = lockConnection();
+
+        vector<int> seats;
         sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+        if (prepare("SELECT total_seats FROM flights WHERE flight_id = ?;", &stmt) != SQLITE_OK)
+        {
+            return seats;
+        }
         sqlite3_bind_int(stmt, 1, flightId);
-        rc = sqlite3_step(stmt);
-        int count = sqlite3_column_int(stmt, 0);
+        int totalSeats = step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
         sqlite3_finalize(stmt);
-        return count;
-    }
 
-    vector<int> getAvailableSeats(int flightId)
-    {
-        vector<int> seats;
         string sql = "SELECT seat_number FROM bookings WHERE flight_id = ? "
                      "AND status = 'CONFIRMED';";
 
-        sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+        int rc = prepare(sql, &stmt);
 
         sqlite3_bind_int(stmt, 1, flightId);
 
-        vector<bool> takenSeats(100, false); // Assuming max 100 seats
+        vector<bool> takenSeats(totalSeats > 0 ? totalSeats : 0, false);
+        TraceSpan fetch("sqlite.fetch");
         while (sqlite3_step(stmt) == SQLITE_ROW)
         {
             int seatNum = sqlite3_column_int(stmt, 0);
-            takenSeats[seatNum - 1] = true;
+            // Bookings made before a capacity change can lie outside the cabin
+            if (seatNum >= 1 && seatNum <= totalSeats)
+            {
+                takenSeats[seatNum - 1] = true;
+            }
         }
 
-        for (int i = 0; i < 100; i++)
+        for (int i = 0; i < totalSeats; i++)
         {
             if (!takenSeats[i])
             {
@@ -488,52 +1027,392 @@ public:
     }
 
 private:
-    bool isSeatAvailable(int flightId, int seatNumber)
-    {
-        string sql = "SELECT COUNT(*) FROM bookings WHERE flight_id = ? "
-                     "AND seat_number = ? AND status = 'CONFIRMED';";
+    // The helpers below run under a connection lock their caller already holds
 
+    void readAnalyticsFlights(BookingAnalytics &analytics)
+    {
         sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+        if (prepare("SELECT flight_id, flight_number, destination, departure_date, "
+                    "total_seats, price FROM flights;",
+                    &stmt) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                analytics.addFlight(sqlite3_column_int(stmt, 0),
+                                    reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)),
+                                    reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2)),
+                                    reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3)),
+                                    sqlite3_column_int(stmt, 4),
+                                    sqlite3_column_double(stmt, 5));
+            }
+            sqlite3_finalize(stmt);
+        }
+    }
 
-        sqlite3_bind_int(stmt, 1, flightId);
-        sqlite3_bind_int(stmt, 2, seatNumber);
+    int getBookedSeatsCount(int flightId)
+    {
+        TraceSpan span("db.getBookedSeatsCount");
 
-        rc = sqlite3_step(stmt);
+        string sql = "SELECT COUNT(*) FROM bookings WHERE flight_id = ? AND status = 'CONFIRMED';";
+        sqlite3_stmt *stmt;
+        int rc = prepare(sql, &stmt);
+        sqlite3_bind_int(stmt, 1, flightId);
+        rc = step(stmt);
         int count = sqlite3_column_int(stmt, 0);
-
         sqlite3_finalize(stmt);
-        return count == 0;
+        return count;
     }
-};
+
+    // The lookup behind findBooking, also run inside transitionBooking's transaction
+    bool readBooking(int bookingId, int &flightId, string &status, int *seatNumber)
+    {
+        string sql = "SELECT flight_id, status, seat_number FROM bookings WHERE booking_id = ?;";
+
+        sqlite3_stmt *stmt;
+        int rc = prepare(sql, &stmt);
+
+        if (rc != SQLITE_OK)
+        {
+            return false;
+        }
+
+        sqlite3_bind_int(stmt, 1, bookingId);
+
+        rc = step(stmt);
+        bool found = rc == SQLITE_ROW;
+        if (found)
+        {
+            flightId = sqlite3_column_int(stmt, 0);
+            status = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+            if (seatNumber)
+            {
+                *seatNumber = sqlite3_column_int(stmt, 2);
+            }
+        }
+        sqlite3_finalize(stmt);
+        return found;
+    }
+
+    // The flight has the seat and no CONFIRMED booking holds it, the same rule
+    // the shared inventory's claim() applies
+    bool isSeatAvailable(int flightId, int seatNumber)
+    {
+        TraceSpan span("db.isSeatAvailable");
+
+        string sql = "SELECT EXISTS (SELECT 1 FROM flights WHERE flight_id = ?1 "
+                     "AND ?2 BETWEEN 1 AND total_seats) "
+                     "AND NOT EXISTS (SELECT 1 FROM bookings WHERE flight_id = ?1 "
+                     "AND seat_number = ?2 AND status = 'CONFIRMED');";
+
+        sqlite3_stmt *stmt;
+        int rc = prepare(sql, &stmt);
+
+        sqlite3_bind_int(stmt, 1, flightId);
+        sqlite3_bind_int(stmt, 2, seatNumber);
+
+        rc = step(stmt);
+        bool available = rc == SQLITE_ROW && sqlite3_column_int(stmt, 0) == 1;
+
+        sqlite3_finalize(stmt);
+        return available;
+    }
+};
 
 class FlightBookingSystem
 {
 private:
     Database db;
+    BookingAnalytics bookingAnalytics;
+    SeatInventory *inventory = nullptr;       // shared with the other workers in pre-fork mode
+    std::mutex analyticsMutex;                // one copy from the shared counters at a time
+    uint64_t analyticsChanges = UINT64_MAX;   // inventory->bookingChanges() the counts were copied at
+
+    // Committed changes reach the aggregates through these. With other workers
+    // they go to the shared counters instead, which every worker (this one
+    // included) copies before its next analytics read.
+    void recordBookings(int flightId, int count)
+    {
+        string day = BookingAnalytics::dayKey(time(0));
+        if (inventory)
+        {
+            inventory->addBookings(flightId, count);
+            inventory->addDayBookings(BookingAnalytics::dayNumber(day), count);
+            inventory->noteBookingChange();
+            return;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            bookingAnalytics.bookingAdded(flightId, day);
+        }
+    }
+
+    void recordCancellation(int flightId)
+    {
+        if (inventory)
+        {
+            inventory->addBookings(flightId, -1);
+            inventory->noteBookingChange();
+            return;
+        }
+        bookingAnalytics.bookingCancelled(flightId);
+    }
+
+    void recordMove(int oldFlightId, bool wasActive, int newFlightId)
+    {
+        if (inventory)
+        {
+            if (wasActive)
+            {
+                inventory->addBookings(oldFlightId, -1);
+            }
+            inventory->addBookings(newFlightId, +1);
+            inventory->noteBookingChange();
+            return;
+        }
+        bookingAnalytics.bookingMoved(oldFlightId, wasActive, newFlightId);
+    }
 
 public:
+    // With a shared inventory the analytics counts come from its counters, which
+    // the supervisor has loaded; otherwise they are built from SQLite here
+    explicit FlightBookingSystem(SeatInventory *sharedInventory = nullptr)
+        : inventory(sharedInventory && sharedInventory->active() ? sharedInventory : nullptr)
+    {
+        if (!inventory)
+        {
+            db.loadAnalytics(bookingAnalytics);
+        }
+    }
+
     bool addFlight(const string &flightNumber, const string &destination,
                    const string &departureDate, int totalSeats,
                    const string &classType, double price)
     {
-        return db.addFlight(flightNumber, destination, departureDate,
-                            totalSeats, classType, price);
+        // Held off during a reload, which rewrites the counters the flight gets
+        SeatInventory::Update update(inventory);
+        int flightId = 0;
+        if (!db.addFlight(flightNumber, destination, departureDate,
+                          totalSeats, classType, price, &flightId))
+        {
+            return false;
+        }
+        bookingAnalytics.addFlight(flightId, flightNumber, destination, departureDate, totalSeats, price);
+        if (inventory)
+        {
+            inventory->addFlight(flightId, totalSeats, price);
+            inventory->noteBookingChange();
+        }
+        return true;
     }
 
     bool bookSeat(int flightId, const string &passengerName,
                   const string &passengerEmail, int seatNumber)
     {
-        return db.bookSeat(flightId, passengerName, passengerEmail, seatNumber);
+        // A seat another worker already holds, or one the flight does not have, is
+        // turned away without touching SQLite
+        SeatInventory::Update update(inventory);
+        SeatInventory::Claim claim = inventory ? inventory->claim(flightId, seatNumber)
+                                               : SeatInventory::Claim::Untracked;
+        if (claim == SeatInventory::Claim::Taken || claim == SeatInventory::Claim::NoSuchSeat)
+        {
+            return false;
+        }
+        if (!db.bookSeat(flightId, passengerName, passengerEmail, seatNumber))
+        {
+            if (claim == SeatInventory::Claim::Claimed)
+            {
+                inventory->release(flightId, seatNumber);
+            }
+            return false;
+        }
+        recordBookings(flightId, 1);
+        return true;
+    }
+
+    // Frees the seat of a booking this call moved out of CONFIRMED. Only the
+    // transition read inside the update's transaction is trusted: a stale status
+    // would clear a bit that a later booking of the same seat now holds.
+    void releaseIfConfirmed(const BookingTransition &transition)
+    {
+        if (inventory && transition.previousStatus == "CONFIRMED")
+        {
+            inventory->release(transition.flightId, transition.seatNumber);
+        }
     }
 
     bool rescheduleBooking(int bookingId, int newFlightId, const string &newDate)
     {
-        return db.rescheduleBooking(bookingId, newFlightId, newDate);
+        SeatInventory::Update update(inventory);
+        BookingTransition transition;
+        if (!db.rescheduleBooking(bookingId, newFlightId, newDate, transition))
+        {
+            return false;
+        }
+        if (transition.changed)
+        {
+            recordMove(transition.flightId, transition.previousStatus != "CANCELLED", newFlightId);
+            // RESCHEDULED bookings no longer hold a seat
+            releaseIfConfirmed(transition);
+        }
+        return true;
+    }
+
+    // Cancelling an already cancelled booking succeeds without changing anything
+    bool cancelBooking(int bookingId)
+    {
+        SeatInventory::Update update(inventory);
+        BookingTransition transition;
+        if (!db.cancelBooking(bookingId, transition))
+        {
+            return false;
+        }
+        if (transition.changed)
+        {
+            recordCancellation(transition.flightId);
+            releaseIfConfirmed(transition);
+        }
+        return true;
+    }
+
+    // Holds every seat in the shared inventory, or none if another worker has one
+    bool claimSeats(int flightId, const vector<int> &seats)
+    {
+        if (!inventory)
+        {
+            return true;
+        }
+        for (size_t i = 0; i < seats.size(); ++i)
+        {
+            SeatInventory::Claim claim = inventory->claim(flightId, seats[i]);
+            if (claim == SeatInventory::Claim::Taken || claim == SeatInventory::Claim::NoSuchSeat)
+            {
+                releaseSeats(flightId, vector<int>(seats.begin(), seats.begin() + i));
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void releaseSeats(int flightId, const vector<int> &seats)
+    {
+        if (inventory)
+        {
+            for (int seat : seats)
+            {
+                inventory->release(flightId, seat);
+            }
+        }
+    }
+
+    enum class AssignResult
+    {
+        Assigned,
+        NoFlight,
+        NoBlock
+    };
+
+    // Picks the best block of adjacent seats from the flight's layout and books them
+    // in one transaction. If another request takes one of the seats first the search
+    // runs again against the fresh occupancy.
+    AssignResult assignSeats(int flightId, const string &passengerName, const string &passengerEmail,
+                             int partySize, const string &zone, SeatLayout &layout, vector<int> &seats)
+    {
+        if (!db.getSeatLayout(flightId, layout))
+        {
+            return AssignResult::NoFlight;
+        }
+        vector<int> taken;
+        for (int attempt = 0; attempt < 3; ++attempt)
+        {
+            if (!inventory || !inventory->takenSeats(flightId, taken))
+            {
+                taken = db.getTakenSeats(flightId);
+            }
+            SeatOccupancy occupancy(layout);
+            for (int seat : taken)
+            {
+                occupancy.markTaken(seat);
+            }
+            {
+                TraceSpan span("seats.findBlock");
+                if (!SeatAssigner::findBlock(layout, occupancy, partySize, zone, seats))
+                {
+                    return AssignResult::NoBlock;
+                }
+            }
+            SeatInventory::Update update(inventory);
+            if (!claimSeats(flightId, seats))
+            {
+                continue;
+            }
+            if (db.bookSeats(flightId, passengerName, passengerEmail, seats))
+            {
+                recordBookings(flightId, static_cast<int>(seats.size()));
+                return AssignResult::Assigned;
+            }
+            releaseSeats(flightId, seats);
+        }
+        return AssignResult::NoBlock;
+    }
+
+    BookingAnalytics &analytics()
+    {
+        // Another worker's changes reach these aggregates through the shared
+        // counters, copied whenever the change count has moved
+        if (inventory)
+        {
+            std::lock_guard<std::mutex> lock(analyticsMutex);
+            uint64_t changes = inventory->bookingChanges();
+            if (changes != analyticsChanges)
+            {
+                vector<SeatInventory::FlightCounters> flights;
+                vector<std::pair<int32_t, int32_t>> days;
+                inventory->flightCounters(flights);
+                inventory->dayCounters(days);
+
+                vector<BookingAnalytics::FlightCount> counts;
+                bool missingFlight = false;
+                for (const auto &flight : flights)
+                {
+                    counts.push_back({flight.flightId, flight.activeBookings, flight.revenueCents / 100.0});
+                    missingFlight = missingFlight || !bookingAnalytics.hasFlight(flight.flightId);
+                }
+                // Flights added since, by any worker: only the flights table is read
+                if (missingFlight)
+                {
+                    db.loadAnalyticsFlights(bookingAnalytics);
+                }
+                std::map<string, int> perDay;
+                for (const auto &[day, count] : days)
+                {
+                    perDay[BookingAnalytics::dayKeyFromNumber(day)] += count;
+                }
+                bookingAnalytics.replaceCounts(counts, std::move(perDay));
+                analyticsChanges = changes;
+            }
+        }
+        return bookingAnalytics;
+    }
+
+    TableClaim claimIdempotencyKey(const string &key, uint64_t fingerprint, int64_t now, int64_t leaseUntil,
+                                   uint64_t &storedFingerprint, StoredResponse &response)
+    {
+        return db.claimIdempotencyKey(key, fingerprint, now, leaseUntil, storedFingerprint, response);
+    }
+
+    void abandonIdempotencyKey(const string &key)
+    {
+        db.abandonIdempotencyKey(key);
     }
 
-    bool cancelBooking(int bookingId) {
-    return db.cancelBooking(bookingId);
+    void saveIdempotencyKey(const string &key, uint64_t fingerprint, const StoredResponse &response, int64_t expiresAt)
+    {
+        db.saveIdempotencyKey(key, fingerprint, response, expiresAt);
+    }
+
+    void purgeIdempotencyKeys(int64_t now, bool pendingClaims)
+    {
+        db.purgeIdempotencyKeys(now, pendingClaims);
     }
     vector<nlohmann::json> getAvailableFlights()
     {
@@ -542,12 +1421,22 @@ public:
 
     vector<int> getAvailableSeats(int flightId)
     {
+        vector<int> seats;
+        if (inventory && inventory->freeSeats(flightId, seats))
+        {
+            return seats;
+        }
         return db.getAvailableSeats(flightId);
     }
     vector<json> getBookedFlights(const string& email = "") {
     return db.getBookedFlights(email);
 }
 
+    int exportBookings(int &afterId, int limit, string &out)
+    {
+        return db.exportBookings(afterId, limit, out);
+    }
+
     
 };
 class CombinedServer
@@ -556,107 +1445,379 @@ private:
     UserRegistrationSystem registrationSystem;
     FlightBookingSystem bookingSystem;
     httplib::Server server;
+    ServerConfig config;
+    ResponseCompressor compressor;
+    RateLimiter rateLimiter;
+    TrafficCapture capture;
+    IdempotencyCache idempotency;
+
+    // API routes are matched by the trie, in pre-routing unless the request has a
+    // body; httplib's own routing only sees requests with a body (one catch-all
+    // pattern per method), CORS preflights and static files
+    using RouteHandler = std::function<void(const httplib::Request &, httplib::Response &, const RouteParams &)>;
+    Router<RouteHandler> router;
+
+    template <typename T>
+    static bool decodeBody(const httplib::Request &req, T &request, std::string &error)
+    {
+        TraceSpan span("json.decode");
+        return decodeRequest(req.body, request, error);
+    }
+
+    // Claims `key` in the idempotency_keys table, which every worker shares, after
+    // this process's cache let the request through. While another worker has the
+    // key pending this waits for its result; a stored row turns `claim` into a
+    // Replay or Mismatch, and running out of time into InProgress.
+    void claimSharedKey(const std::string &key, uint64_t fingerprint, int64_t now, IdempotencyCache::Claim &claim)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(config.idempotency.waitSeconds);
+        for (;;)
+        {
+            uint64_t storedFingerprint = 0;
+            StoredResponse stored;
+            TableClaim tableClaim = bookingSystem.claimIdempotencyKey(
+                key, fingerprint, now, now + config.idempotency.leaseSeconds, storedFingerprint, stored);
+            if (tableClaim == TableClaim::Claimed)
+            {
+                return;
+            }
+            if (storedFingerprint != fingerprint)
+            {
+                idempotency.abandon(key, claim.entry);
+                claim.outcome = IdempotencyCache::Outcome::Mismatch;
+                return;
+            }
+            if (tableClaim == TableClaim::Stored)
+            {
+                idempotency.complete(key, claim.entry, stored, now);
+                claim.outcome = IdempotencyCache::Outcome::Replay;
+                claim.response = std::move(stored);
+                return;
+            }
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                idempotency.abandon(key, claim.entry);
+                claim.outcome = IdempotencyCache::Outcome::InProgress;
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            now = IdempotencyCache::nowSeconds();
+        }
+    }
+
+    // Idempotency-Keys are scoped to the client IP for requests that name no account
+    static std::string clientScope(const httplib::Request &req)
+    {
+        return "ip:" + req.remote_addr;
+    }
+
+    // There are no sessions, so a booking's account is the passenger_email it is
+    // made for, as with the rate limits
+    template <typename Request>
+    static std::string accountScope(const httplib::Request &req)
+    {
+        Request request;
+        std::string error;
+        if (decodeBody(req, request, error) && !request.passengerEmail.empty())
+        {
+            return "acct:" + request.passengerEmail;
+        }
+        return clientScope(req);
+    }
+
+    // Runs `handler` at most once per Idempotency-Key within the scope `scope`
+    // gives the request, so one client cannot replay or block another's key.
+    // Retries and concurrent duplicates get the first response back, from
+    // memory or, on a miss there, from the idempotency_keys table (written by
+    // another worker, or before a restart), without the handler running again.
+    // Requests without the header are passed straight through.
+    template <typename Scope, typename Handler>
+    RouteHandler idempotent(Scope scope, Handler handler)
+    {
+        return [this, scope, handler](const httplib::Request &req, httplib::Response &res, const RouteParams &params)
+        {
+            const std::string header = req.get_header_value("Idempotency-Key");
+            if (header.empty() || !config.idempotency.enabled)
+            {
+                handler(req, res, params);
+                return;
+            }
+
+            res.set_header("Access-Control-Allow-Origin", "*");
+            res.set_header("Content-Type", "application/json");
+            if (header.size() > IdempotencyCache::maxKeyLength)
+            {
+                res.status = 400;
+                res.body = JsonResponse::idempotencyKeyTooLong;
+                return;
+            }
+            // A header value cannot hold a newline, so scopes cannot run into keys
+            const std::string key = scope(req) + '\n' + header;
+
+            uint64_t fingerprint = IdempotencyCache::fingerprint(req.method, req.path, req.body);
+            int64_t now = IdempotencyCache::nowSeconds();
+            IdempotencyCache::Claim claim = idempotency.claim(key, fingerprint, now);
+
+            if (claim.outcome == IdempotencyCache::Outcome::Execute)
+            {
+                claimSharedKey(key, fingerprint, now, claim);
+            }
+
+            switch (claim.outcome)
+            {
+            case IdempotencyCache::Outcome::Replay:
+                res.status = claim.response.status;
+                res.body = std::move(claim.response.body);
+                res.set_header("Idempotent-Replayed", "true");
+                return;
+            case IdempotencyCache::Outcome::Mismatch:
+                res.status = 422;
+                res.body = JsonResponse::idempotencyKeyReused;
+                return;
+            case IdempotencyCache::Outcome::InProgress:
+                res.status = 409;
+                res.body = JsonResponse::idempotencyKeyInProgress;
+                return;
+            case IdempotencyCache::Outcome::Execute:
+                break;
+            }
+
+            try
+            {
+                handler(req, res, params);
+            }
+            catch (...)
+            {
+                bookingSystem.abandonIdempotencyKey(key);
+                idempotency.abandon(key, claim.entry);
+                throw;
+            }
+
+            // Server errors and rate limiting are transient, so those keys stay retryable
+            if (res.status >= 500 || res.status == 429)
+            {
+                bookingSystem.abandonIdempotencyKey(key);
+                idempotency.abandon(key, claim.entry);
+                return;
+            }
+            StoredResponse response{res.status, res.body};
+            bookingSystem.saveIdempotencyKey(key, fingerprint, response, idempotency.expiryFrom(now));
+            idempotency.complete(key, claim.entry, std::move(response), now);
+        };
+    }
+
+    // Writes a 429 and returns true when `key` has run out of tokens for this route class
+    bool rejectIfLimited(RouteClass routeClass, const std::string &key, httplib::Response &res)
+    {
+        RateLimitDecision decision = rateLimiter.acquire(routeClass, key);
+        if (decision.allowed)
+        {
+            return false;
+        }
+        res.status = 429;
+        res.set_header("Access-Control-Allow-Origin", "*");
+        res.set_header("Content-Type", "application/json");
+        res.set_header("Retry-After", std::to_string(decision.retryAfterSeconds));
+        // A request rejected before routing still has its body on the socket;
+        // closing stops the next request on a keep-alive connection reading it.
+        res.set_header("Connection", "close");
+        res.body = JsonResponse::rateLimited;
+        return true;
+    }
+
+    // True when httplib will read a body after pre-routing. Such a request
+    // cannot be answered there: its handler would see an empty req.body and
+    // the unread body would be parsed as the next request.
+    static bool hasBody(const httplib::Request &req)
+    {
+        if (req.has_header("Transfer-Encoding"))
+        {
+            return true;
+        }
+        const std::string length = req.get_header_value("Content-Length");
+        return !length.empty() && length != "0";
+    }
+
+    // Runs the API handler the trie has for the request; false if it has none
+    bool dispatch(const httplib::Request &req, httplib::Response &res)
+    {
+        RouteParams params;
+        const RouteHandler *handler;
+        {
+            TraceSpan span("route.match");
+            handler = router.match(req.method, req.path, params);
+        }
+        if (!handler)
+        {
+            return false;
+        }
+        (*handler)(req, res, params);
+        return true;
+    }
 
 public:
-    CombinedServer()
+    explicit CombinedServer(const ServerConfig &config = ServerConfig(), SeatInventory *inventory = nullptr,
+                            SharedRateLimits *rateLimits = nullptr)
+        : bookingSystem(inventory), config(config), compressor(config.compression), rateLimiter(config.rateLimit),
+          idempotency(config.idempotency)
     {
+        rateLimiter.share(rateLimits);
+        // Pending claims are cleared here only when this is the sole server process;
+        // the pre-fork supervisor clears them once, before forking
+        bookingSystem.purgeIdempotencyKeys(IdempotencyCache::nowSeconds(), inventory == nullptr);
+
+#ifdef SO_REUSEPORT
+        // Pre-fork workers each bind the same port and the kernel spreads connections between them
+        if (config.prefork.workers > 1)
+        {
+            server.set_socket_options([](socket_t sock)
+                                      {
+                int yes = 1;
+                setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&yes), sizeof(yes));
+                setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char *>(&yes), sizeof(yes)); });
+        }
+#endif
+
+        // Optional request capture for offline replay (tools/flight_replay)
+        capture.start(config.capture);
+
         // Set up static file handling
         server.set_mount_point("/", "./public");
 
+        // Request IDs and tracing, then per-client budgets on auth and booking
+        // writes. API requests without a body are dispatched here, which spares
+        // them httplib's regex routing; a path the trie does not know falls
+        // through to the static files under /.
+        server.set_pre_routing_handler([this](const httplib::Request &req, httplib::Response &res)
+                                       {
+            res.set_header("X-Request-Id", std::to_string(Tracer::instance().beginRequest()));
+            capture.begin();
+
+            RouteClass routeClass = RateLimiter::classify(req.method, req.path);
+            if (routeClass != RouteClass::None && rejectIfLimited(routeClass, req.remote_addr, res)) {
+                return httplib::Server::HandlerResponse::Handled;
+            }
+            if (!hasBody(req) && dispatch(req, res)) {
+                return httplib::Server::HandlerResponse::Handled;
+            }
+            return httplib::Server::HandlerResponse::Unhandled; });
+
+        // Requests with a body reach the trie through one catch-all handler per
+        // method, which httplib only calls once it has read the body
+        auto dispatchWithBody = [this](const httplib::Request &req, httplib::Response &res)
+        {
+            if (!dispatch(req, res))
+            {
+                res.status = 404;
+            }
+        };
+        server.Get(".*", dispatchWithBody);
+        server.Post(".*", dispatchWithBody);
+        server.Put(".*", dispatchWithBody);
+        server.Delete(".*", dispatchWithBody);
+        server.Patch(".*", dispatchWithBody);
+
+        // Compress large API bodies for clients that accept it
+        server.set_post_routing_handler([this](const httplib::Request &req, httplib::Response &res)
+                                        {
+            capture.responseReady(res.body);
+            {
+                TraceSpan span("response.compress");
+                compressor.apply(req, res);
+            }
+            Tracer::instance().markResponseWrite(); });
+
+        // Runs once the response is on the wire
+        server.set_logger([this](const httplib::Request &req, const httplib::Response &res)
+                          {
+            capture.record(req.remote_addr, req.method, req.target.empty() ? req.path : req.target, req.headers, req.body, res.status);
+            Tracer::instance().endRequest(req.method, req.path, res.status); });
+
         // Handle CORS for all endpoints
         server.Options("/.*", [](const httplib::Request &req, httplib::Response &res)
                        {
             res.set_header("Access-Control-Allow-Origin", "*");
             res.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-            res.set_header("Access-Control-Allow-Headers", "Content-Type"); });
+            res.set_header("Access-Control-Allow-Headers", "Content-Type, Idempotency-Key"); });
 
         // Registration endpoints
         setupRegistrationEndpoints();
 
         // Flight booking endpoints
         setupFlightBookingEndpoints();
+
+        // Occupancy and revenue aggregates
+        setupAnalyticsEndpoints();
+
+        // Server counters
+        setupMetricsEndpoints();
     }
 
     void setupRegistrationEndpoints()
     {
-        server.Post("/register", [this](const httplib::Request &req, httplib::Response &res)
+        router.Post("/register", [this](const httplib::Request &req, httplib::Response &res, const RouteParams &)
                     {
             res.set_header("Access-Control-Allow-Origin", "*");
             res.set_header("Content-Type", "application/json");
 
             try {
-                auto requestJson = json::parse(req.body);
-                
-                std::string name = requestJson["name"];
-                std::string email = requestJson["email"];
-                std::string password = requestJson["password"];
-
-                if (registrationSystem.registerUser(name, email, password)) {
-                    json response = {
-                        {"success", true},
-                        {"message", "Registration successful"}
-                    };
+                RegisterRequest request;
+                std::string error;
+                if (!decodeBody(req, request, error)) {
+                    res.status = 400;
+                    JsonResponse::writeMessage(res.body, false, error);
+                    return;
+                }
+
+                if (registrationSystem.registerUser(request.name, request.email, request.password)) {
                     res.status = 200;
-                    res.body = response.dump();
+                    res.body = JsonResponse::registrationSucceeded;
                 } else {
-                    json response = {
-                        {"success", false},
-                        {"message", "Registration failed"}
-                    };
                     res.status = 400;
-                    res.body = response.dump();
+                    res.body = JsonResponse::registrationFailed;
                 }
             } catch (const std::exception& e) {
-                json response = {
-                    {"success", false},
-                    {"message", std::string("Error: ") + e.what()}
-                };
                 res.status = 500;
-                res.body = response.dump();
+                JsonResponse::writeMessage(res.body, false, "Error: ", e.what());
             } });
 
             
 
-        server.Post("/login", [this](const httplib::Request &req, httplib::Response &res)
+        router.Post("/login", [this](const httplib::Request &req, httplib::Response &res, const RouteParams &)
                     {
             res.set_header("Access-Control-Allow-Origin", "*");
             res.set_header("Content-Type", "application/json");
 
             try {
-                auto requestJson = json::parse(req.body);
-                
-                std::string email = requestJson["email"];
-                std::string password = requestJson["password"];
-
-                if (registrationSystem.loginUser(email, password)) {
-                    json response = {
-                        {"success", true},
-                        {"message", "Login successful"}
-                    };
+                LoginRequest request;
+                std::string error;
+                if (!decodeBody(req, request, error)) {
+                    res.status = 400;
+                    JsonResponse::writeMessage(res.body, false, error);
+                    return;
+                }
+
+                if (rejectIfLimited(RouteClass::Auth, "acct:" + request.email, res)) {
+                    return;
+                }
+
+                if (registrationSystem.loginUser(request.email, request.password)) {
                     res.status = 200;
-                    res.body = response.dump();
+                    res.body = JsonResponse::loginSucceeded;
                 } else {
-                    json response = {
-                        {"success", false},
-                        {"message", "Invalid email or password"}
-                    };
                     res.status = 401;
-                    res.body = response.dump();
+                    res.body = JsonResponse::loginFailed;
                 }
             } catch (const std::exception& e) {
-                json response = {
-                    {"success", false},
-                    {"message", std::string("Error: ") + e.what()}
-                };
                 res.status = 500;
-                res.body = response.dump();
+                JsonResponse::writeMessage(res.body, false, "Error: ", e.what());
             } });
     }
 
     void setupFlightBookingEndpoints()
     {
         // GET /api/flights - Get all available flights
-        server.Get("/api/flights", [this](const httplib::Request &req, httplib::Response &res)
+        router.Get("/api/flights", [this](const httplib::Request &, httplib::Response &res, const RouteParams &)
                    {
         res.set_header("Access-Control-Allow-Origin", "*");
         res.set_header("Content-Type", "application/json");
@@ -666,124 +1827,160 @@ public:
             res.status = 200;
             res.body = json(flights).dump(); // Directly serialize the vector of JSON objects
         } catch (const std::exception& e) {
-            json error = {
-                {"error", std::string("Error: ") + e.what()}
-            };
             res.status = 500;
-            res.body = error.dump();
+            JsonResponse::writeError(res.body, "Error: ", e.what());
         } });
 
-        server.Post("/api/flights", [this](const httplib::Request &req, httplib::Response &res)
+        router.Post("/api/flights", [this](const httplib::Request &req, httplib::Response &res, const RouteParams &)
                     {
             res.set_header("Access-Control-Allow-Origin", "*");
             res.set_header("Content-Type", "application/json");
 
             try {
-                auto requestJson = json::parse(req.body);
-                
+                AddFlightRequest request;
+                std::string error;
+                if (!decodeBody(req, request, error)) {
+                    res.status = 400;
+                    JsonResponse::writeMessage(res.body, false, error);
+                    return;
+                }
+
                 bool success = bookingSystem.addFlight(
-                    requestJson["flight_number"],
-                    requestJson["destination"],
-                    requestJson["departure_date"],
-                    requestJson["total_seats"],
-                    requestJson["class_type"],
-                    requestJson["price"]
+                    request.flightNumber,
+                    request.destination,
+                    request.departureDate,
+                    request.totalSeats,
+                    request.classType,
+                    request.price
                 );
 
                 if (success) {
-                    json response = {
-                        {"success", true},
-                        {"message", "Flight added successfully"}
-                    };
                     res.status = 200;
-                    res.body = response.dump();
+                    res.body = JsonResponse::flightAdded;
                 } else {
-                    json response = {
-                        {"success", false},
-                        {"message", "Failed to add flight"}
-                    };
                     res.status = 400;
-                    res.body = response.dump();
+                    res.body = JsonResponse::flightAddFailed;
                 }
             } catch (const std::exception& e) {
-                json error = {
-                    {"error", std::string("Error: ") + e.what()}
-                };
                 res.status = 500;
-                res.body = error.dump();
+                JsonResponse::writeError(res.body, "Error: ", e.what());
             } });
 
         // GET /api/flights/{id}/seats - Get available seats for a flight
-        server.Get(R"(/api/flights/(\d+)/seats)", [this](const httplib::Request &req, httplib::Response &res)
+        router.Get("/api/flights/{id:int}/seats", [this](const httplib::Request &, httplib::Response &res, const RouteParams &params)
                    {
             res.set_header("Access-Control-Allow-Origin", "*");
             res.set_header("Content-Type", "application/json");
 
             try {
-                int flightId = std::stoi(req.matches[1]);
-                auto seats = bookingSystem.getAvailableSeats(flightId);
-                
-                json response = json::array();
-                for (const auto& seat : seats) {
-                    response.push_back(seat);
+                int flightId;
+                if (!params.integer(0, flightId)) {
+                    res.status = 404;
+                    res.body = JsonResponse::flightNotFound;
+                    return;
                 }
-                
+                auto seats = bookingSystem.getAvailableSeats(flightId);
+
                 res.status = 200;
-                res.body = response.dump();
+                JsonResponse::writeIntArray(res.body, seats);
             } catch (const std::exception& e) {
-                json error = {
-                    {"error", std::string("Error: ") + e.what()}
-                };
                 res.status = 500;
-                res.body = error.dump();
+                JsonResponse::writeError(res.body, "Error: ", e.what());
             } });
 
-        server.Post("/api/bookings", [this](const httplib::Request &req, httplib::Response &res)
+        // POST /api/flights/{id}/assign - Book the best block of adjacent seats for a party
+        router.Post("/api/flights/{id:int}/assign", idempotent(accountScope<AssignSeatsRequest>, [this](const httplib::Request &req, httplib::Response &res, const RouteParams &params)
+                    {
+            res.set_header("Access-Control-Allow-Origin", "*");
+            res.set_header("Content-Type", "application/json");
+
+            try {
+                AssignSeatsRequest request;
+                std::string error;
+                if (!decodeBody(req, request, error)) {
+                    res.status = 400;
+                    JsonResponse::writeMessage(res.body, false, error);
+                    return;
+                }
+                if (request.partySize < 1 || request.partySize > SeatLayout::maxSeatsPerRow) {
+                    res.status = 400;
+                    JsonResponse::writeMessage(res.body, false, "Field 'party_size' is out of range");
+                    return;
+                }
+
+                if (rejectIfLimited(RouteClass::BookingWrite, "acct:" + request.passengerEmail, res)) {
+                    return;
+                }
+
+                int flightId;
+                if (!params.integer(0, flightId)) {
+                    res.status = 404;
+                    res.body = JsonResponse::flightNotFound;
+                    return;
+                }
+                SeatLayout layout;
+                vector<int> seats;
+                auto result = bookingSystem.assignSeats(flightId, request.passengerName, request.passengerEmail,
+                                                        request.partySize, request.zone, layout, seats);
+
+                if (result == FlightBookingSystem::AssignResult::NoFlight) {
+                    res.status = 404;
+                    res.body = JsonResponse::flightNotFound;
+                } else if (result == FlightBookingSystem::AssignResult::NoBlock) {
+                    res.status = 409;
+                    res.body = JsonResponse::noAdjacentSeats;
+                } else {
+                    json labels = json::array();
+                    for (int seat : seats) {
+                        labels.push_back(layout.label(seat));
+                    }
+                    res.status = 200;
+                    res.body = json{{"success", true}, {"seats", seats}, {"labels", labels}}.dump();
+                }
+            } catch (const std::exception& e) {
+                res.status = 500;
+                JsonResponse::writeMessage(res.body, false, "Error: ", e.what());
+            } }));
+
+        router.Post("/api/bookings", idempotent(accountScope<BookingRequest>, [this](const httplib::Request &req, httplib::Response &res, const RouteParams &)
                     {
         res.set_header("Access-Control-Allow-Origin", "*");
         res.set_header("Content-Type", "application/json");
 
         try {
-            auto requestJson = json::parse(req.body);
-            
-            int flightId = requestJson["flight_id"];
-            std::string passengerName = requestJson["passenger_name"];
-            std::string passengerEmail = requestJson["passenger_email"];
-            int seatNumber = requestJson["seat_number"];
+            BookingRequest request;
+            std::string error;
+            if (!decodeBody(req, request, error)) {
+                res.status = 400;
+                JsonResponse::writeMessage(res.body, false, error);
+                return;
+            }
+
+            if (rejectIfLimited(RouteClass::BookingWrite, "acct:" + request.passengerEmail, res)) {
+                return;
+            }
 
             bool success = bookingSystem.bookSeat(
-                flightId,
-                passengerName,
-                passengerEmail,
-                seatNumber
+                request.flightId,
+                request.passengerName,
+                request.passengerEmail,
+                request.seatNumber
             );
 
             if (success) {
-                json response = {
-                    {"success", true},
-                    {"message", "Flight booked successfully"}
-                };
                 res.status = 200;
-                res.body = response.dump();
+                res.body = JsonResponse::bookingSucceeded;
             } else {
-                json response = {
-                    {"success", false},
-                    {"message", "Failed to book flight. Seat may no longer be available."}
-                };
                 res.status = 400;
-                res.body = response.dump();
+                res.body = JsonResponse::bookingFailed;
             }
         } catch (const std::exception& e) {
-            json error = {
-                {"success", false},
-                {"message", std::string("Error: ") + e.what()}
-            };
             res.status = 500;
-            res.body = error.dump();
-        } });
+            JsonResponse::writeMessage(res.body, false, "Error: ", e.what());
+        } }));
 
         // Add this inside setupFlightBookingEndpoints()
-           server.Get("/api/bookings", [this](const httplib::Request& req, httplib::Response& res) {
+           router.Get("/api/bookings", [this](const httplib::Request& req, httplib::Response& res, const RouteParams &) {
             res.set_header("Access-Control-Allow-Origin", "*");
             res.set_header("Content-Type", "application/json");
 
@@ -797,90 +1994,168 @@ public:
                 res.status = 200;
                 res.body = json(bookings).dump();
             } catch (const std::exception& e) {
-                json error = {
-                    {"error", std::string("Error: ") + e.what()}
-                };
                 res.status = 500;
-                res.body = error.dump();
+                JsonResponse::writeError(res.body, "Error: ", e.what());
             }
 });
 
-server.Delete(R"(/api/bookings/(\d+))", [this](const httplib::Request &req, httplib::Response &res) {
+        // GET /api/bookings/export - Every booking, streamed page by page as one
+        // chunked JSON array, so neither side holds the whole table in memory
+        router.Get("/api/bookings/export", [this](const httplib::Request &req, httplib::Response &res, const RouteParams &)
+                   {
+            constexpr int pageRows = 256;
+            struct ExportCursor
+            {
+                int afterId = 0;
+                bool started = false;
+            };
+            auto cursor = std::make_shared<ExportCursor>();
+
+            res.set_header("Access-Control-Allow-Origin", "*");
+            res.status = 200;
+            compressor.setChunkedContent(req, res, "application/json", [this, cursor](size_t, httplib::DataSink &sink)
+                                         {
+                std::string chunk;
+                if (!cursor->started) {
+                    chunk += '[';
+                }
+                int rows;
+                try {
+                    rows = bookingSystem.exportBookings(cursor->afterId, pageRows, chunk);
+                } catch (const std::exception &e) {
+                    LOG_ERROR("server", "Booking export failed after booking %d: %s", cursor->afterId, e.what());
+                    return false; // drops the connection, so the client sees a truncated body
+                }
+                cursor->started = true;
+                if (rows < pageRows) {
+                    chunk += ']';
+                }
+                if (!sink.write(chunk.data(), chunk.size())) {
+                    return false;
+                }
+                if (rows < pageRows) {
+                    sink.done();
+                }
+                return true; }); });
+
+router.Delete("/api/bookings/{id:int}", idempotent(clientScope, [this](const httplib::Request &, httplib::Response &res, const RouteParams &params) {
     res.set_header("Access-Control-Allow-Origin", "*");
     res.set_header("Content-Type", "application/json");
 
     try {
-        int bookingId = std::stoi(req.matches[1]);
-        bool success = bookingSystem.cancelBooking(bookingId);
+        int bookingId;
+        bool success = params.integer(0, bookingId) && bookingSystem.cancelBooking(bookingId);
 
         if (success) {
-            json response = {
-                {"success", true},
-                {"message", "Booking cancelled successfully"}
-            };
             res.status = 200;
-            res.body = response.dump();
+            res.body = JsonResponse::cancelSucceeded;
         } else {
-            json response = {
-                {"success", false},
-                {"message", "Failed to cancel booking"}
-            };
             res.status = 400;
-            res.body = response.dump();
+            res.body = JsonResponse::cancelFailed;
         }
     } catch (const std::exception &e) {
-        json error = {
-            {"error", std::string("Error: ") + e.what()}
-        };
         res.status = 500;
-        res.body = error.dump();
+        JsonResponse::writeError(res.body, "Error: ", e.what());
     }
-});
+}));
 
         // PUT /api/bookings/reschedule - Reschedule a booking
-        server.Put("/api/bookings/reschedule", [this](const httplib::Request &req, httplib::Response &res)
+        router.Put("/api/bookings/reschedule", [this](const httplib::Request &req, httplib::Response &res, const RouteParams &)
                    {
         res.set_header("Access-Control-Allow-Origin", "*");
         res.set_header("Content-Type", "application/json");
 
         try {
-            auto requestJson = json::parse(req.body);
-            
-            int bookingId = requestJson["booking_id"];
-            int newFlightId = requestJson["new_flight_id"];
-            std::string newDate = requestJson["new_date"];
+            RescheduleRequest request;
+            std::string error;
+            if (!decodeBody(req, request, error)) {
+                res.status = 400;
+                JsonResponse::writeMessage(res.body, false, error);
+                return;
+            }
 
-            bool success = bookingSystem.rescheduleBooking(bookingId, newFlightId, newDate);
+            bool success = bookingSystem.rescheduleBooking(request.bookingId, request.newFlightId, request.newDate);
 
             if (success) {
-                json response = {
-                    {"success", true},
-                    {"message", "Flight rescheduled successfully"}
-                };
                 res.status = 200;
-                res.body = response.dump();
+                res.body = JsonResponse::rescheduleSucceeded;
             } else {
-                json response = {
-                    {"success", false},
-                    {"message", "Failed to reschedule flight"}
-                };
                 res.status = 400;
-                res.body = response.dump();
+                res.body = JsonResponse::rescheduleFailed;
             }
         } catch (const std::exception& e) {
-            json error = {
-                {"success", false},
-                {"message", std::string("Error: ") + e.what()}
-            };
             res.status = 500;
-            res.body = error.dump();
+            JsonResponse::writeMessage(res.body, false, "Error: ", e.what());
         } });
     }
 
-    void start(const char *host = "localhost", int port = 8080)
+    void setupAnalyticsEndpoints()
     {
-        std::cout << "Server starting on " << host << ":" << port << std::endl;
+        // GET /api/analytics/flights - Load factor per flight
+        router.Get("/api/analytics/flights", [this](const httplib::Request &, httplib::Response &res, const RouteParams &)
+                   {
+            res.set_header("Access-Control-Allow-Origin", "*");
+            res.set_header("Content-Type", "application/json");
+            res.status = 200;
+            res.body = bookingSystem.analytics().flightsJson(); });
+
+        // GET /api/analytics/destinations - Active bookings and revenue per destination
+        router.Get("/api/analytics/destinations", [this](const httplib::Request &, httplib::Response &res, const RouteParams &)
+                   {
+            res.set_header("Access-Control-Allow-Origin", "*");
+            res.set_header("Content-Type", "application/json");
+            res.status = 200;
+            res.body = bookingSystem.analytics().destinationsJson(); });
+
+        // GET /api/analytics/velocity - Bookings made per day
+        router.Get("/api/analytics/velocity", [this](const httplib::Request &, httplib::Response &res, const RouteParams &)
+                   {
+            res.set_header("Access-Control-Allow-Origin", "*");
+            res.set_header("Content-Type", "application/json");
+            res.status = 200;
+            res.body = bookingSystem.analytics().velocityJson(); });
+    }
+
+    void setupMetricsEndpoints()
+    {
+        // GET /api/metrics - Server counters
+        router.Get("/api/metrics", [this](const httplib::Request &, httplib::Response &res, const RouteParams &)
+                   {
+            res.set_header("Access-Control-Allow-Origin", "*");
+            res.set_header("Content-Type", "application/json");
+
+            json metrics = {
+                {"compression", {
+                    {"responses", compressor.compressedResponses()},
+                    {"bytes_in", compressor.uncompressedBytes()},
+                    {"bytes_out", compressor.compressedBytes()},
+                    {"ratio", compressor.compressionRatio()}
+                }},
+                {"capture", {
+                    {"captured", capture.captured()},
+                    {"dropped", capture.dropped()}
+                }},
+                {"idempotency", {
+                    {"entries", idempotency.size()},
+                    {"replayed", idempotency.replayed()},
+                    {"waited", idempotency.waited()}
+                }},
+                {"logging", {
+                    {"dropped", Logger::instance().dropped()}
+                }},
+                {"rate_limit", {
+                    {"rejected", rateLimiter.rejectedRequests()},
+                    {"table_full", rateLimiter.tableFullRejections()},
+                    {"buckets", rateLimiter.trackedBuckets()}
+                }}
+            };
+            res.status = 200;
+            res.body = metrics.dump(); });
+    }
 
+    // Run once before any workers are forked, so they never race to copy the files
+    static void preparePublicDirectory()
+    {
         // Ensure the public directory exists
         if (!std::filesystem::exists("public"))
         {
@@ -896,21 +2171,154 @@ server.Delete(R"(/api/bookings/(\d+))", [this](const httplib::Request &req, http
         {
             std::filesystem::copy_file("flight.js", "public/js/flight.js");
         }
+    }
+
+    void start(const char *host = "localhost", int port = 8080)
+    {
+        std::cout << "Server starting on " << host << ":" << port << std::endl;
+
+        preparePublicDirectory();
 
         server.listen(host, port);
     }
+
+    // Makes listen() return; safe to call from a signal handler
+    void stop()
+    {
+        server.stop();
+    }
 };
 
+namespace
+{
+    CombinedServer *runningServer = nullptr;
+
+    void stopRunningServer(int)
+    {
+        if (runningServer)
+        {
+            runningServer->stop();
+        }
+    }
+
+    int serve(const ServerConfig &config, SeatInventory *inventory = nullptr, SharedRateLimits *rateLimits = nullptr)
+    {
+        Logger::instance().start(config.logging);
+        Tracer::instance().configure(config.tracing);
+
+        CombinedServer server(config, inventory, rateLimits);
+        runningServer = &server;
+        server.start(config.host.c_str(), config.port);
+        runningServer = nullptr;
+        Logger::instance().stop();
+        return 0;
+    }
+
+#if defined(__linux__)
+    // Pre-fork mode: the supervisor maps the shared seat inventory, loads it from
+    // SQLite and forks config.prefork.workers servers that each accept on the port.
+    int servePreforked(const ServerConfig &config)
+    {
+        // Longer than SQLite's busy timeout, so a worker's pending write can finish
+        constexpr int reloadWaitMs = 10000;
+
+        SeatInventory inventory;
+        if (!inventory.create(config.prefork.inventoryFlights, config.prefork.workers))
+        {
+            std::cerr << "Shared seat inventory unavailable; serving from one process" << std::endl;
+            return serve(config);
+        }
+        // Per-worker budgets would give each client one budget per worker
+        SharedRateLimits rateLimits;
+        if (config.rateLimit.enabled && !rateLimits.create(config.prefork.rateLimitKeys, RateLimiter::nowNs()))
+        {
+            std::cerr << "Shared rate limits unavailable; serving from one process" << std::endl;
+            return serve(config);
+        }
+
+        // The supervisor forks again after a crash, so it must stay single-threaded:
+        // no logger thread here, and no SQLite connection held across fork()
+        Logger::instance().setLevel(LogLevel::Off);
+        CombinedServer::preparePublicDirectory();
+        {
+            UserRegistrationSystem users;
+            users.useWriteAheadLog();
+            Database flights;
+            flights.useWriteAheadLog();
+            flights.purgeIdempotencyKeys(IdempotencyCache::nowSeconds(), true);
+            flights.loadSeatInventory(inventory);
+        }
+
+        std::cout << "Supervisor starting " << config.prefork.workers << " workers on "
+                  << config.host << ":" << config.port << std::endl;
+
+        PreforkSupervisor supervisor(
+            config.prefork.workers,
+            [&](int index, int generation)
+            {
+                ServerConfig workerConfig = config;
+                workerConfig.logging.path = workerPath(config.logging.path, index);
+                workerConfig.tracing.path = workerPath(config.tracing.path, index);
+                workerConfig.capture.path = workerPath(config.capture.path, index);
+                workerConfig.tracing.firstRequestId = workerFirstRequestId(index, generation);
+                workerConfig.tracing.processId = static_cast<int>(getpid());
+                inventory.attachWorker(index);
+                std::signal(SIGTERM, stopRunningServer);
+                try
+                {
+                    return serve(workerConfig, &inventory, &rateLimits);
+                }
+                catch (const std::exception &e)
+                {
+                    LOG_ERROR("server", "Worker error: %s", e.what());
+                    Logger::instance().stop();
+                    std::cerr << "Worker " << index << " error: " << e.what() << std::endl;
+                    return 1;
+                }
+            },
+            [&](int index)
+            {
+                // A worker can die holding seat claims it never committed. The
+                // others are held off while the bits are rebuilt, so claims they
+                // have not committed yet are not overwritten.
+                if (!inventory.beginReload(index, reloadWaitMs))
+                {
+                    std::cerr << "Workers still updating seats after " << reloadWaitMs
+                              << " ms; reloading the seat inventory anyway" << std::endl;
+                }
+                {
+                    Database flights;
+                    flights.loadSeatInventory(inventory);
+                }
+                inventory.endReload();
+            });
+        return supervisor.run();
+    }
+#endif
+}
+
 int main()
 {
     try
     {
-        CombinedServer server;
-        server.start();
-        return 0;
+        ServerConfig config = ServerConfig::fromEnvironment();
+#if defined(__linux__)
+        if (config.prefork.workers > 1)
+        {
+            return servePreforked(config);
+        }
+#else
+        if (config.prefork.workers > 1)
+        {
+            std::cerr << "FLIGHT_WORKERS is only supported on Linux; serving from one process" << std::endl;
+        }
+#endif
+        return serve(config);
     }
     catch (const std::exception &e)
     {
+        LOG_ERROR("server", "Server error: %s", e.what());
+        Logger::instance().stop();
         std::cerr << "Server error: " << e.what() << std::endl;
         return 1;
     }
@@ -0,0 +1,500 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json_writer.h"
+
+// Typed request bodies for the JSON endpoints. Each struct lists its fields in a
+// RequestSchema specialisation and is filled directly by a SAX pass over the
+// body, so no intermediate nlohmann DOM is built per request.
+
+enum class FieldType
+{
+    String,
+    Int,
+    Number
+};
+
+template <typename T>
+struct FieldSpec
+{
+    const char *name;
+    FieldType type;
+    std::string T::*stringMember;
+    int T::*intMember;
+    double T::*numberMember;
+    bool required;
+};
+
+template <typename T>
+constexpr FieldSpec<T> requestField(const char *name, std::string T::*member, bool required = true)
+{
+    return {name, FieldType::String, member, nullptr, nullptr, required};
+}
+
+template <typename T>
+constexpr FieldSpec<T> requestField(const char *name, int T::*member, bool required = true)
+{
+    return {name, FieldType::Int, nullptr, member, nullptr, required};
+}
+
+template <typename T>
+constexpr FieldSpec<T> requestField(const char *name, double T::*member, bool required = true)
+{
+    return {name, FieldType::Number, nullptr, nullptr, member, required};
+}
+
+template <typename T>
+struct RequestSchema;
+
+struct RegisterRequest
+{
+    std::string name;
+    std::string email;
+    std::string password;
+};
+
+struct LoginRequest
+{
+    std::string email;
+    std::string password;
+};
+
+struct AddFlightRequest
+{
+    std::string flightNumber;
+    std::string destination;
+    std::string departureDate;
+    int totalSeats = 0;
+    std::string classType;
+    double price = 0.0;
+};
+
+struct BookingRequest
+{
+    int flightId = 0;
+    std::string passengerName;
+    std::string passengerEmail;
+    int seatNumber = 0;
+};
+
+struct AssignSeatsRequest
+{
+    std::string passengerName;
+    std::string passengerEmail;
+    int partySize = 0;
+    std::string zone; // optional class zone, e.g. "Business"
+};
+
+struct RescheduleRequest
+{
+    int bookingId = 0;
+    int newFlightId = 0;
+    std::string newDate;
+};
+
+template <>
+struct RequestSchema<RegisterRequest>
+{
+    static constexpr FieldSpec<RegisterRequest> fields[] = {
+        requestField("name", &RegisterRequest::name),
+        requestField("email", &RegisterRequest::email),
+        requestField("password", &RegisterRequest::password)};
+};
+
+template <>
+struct RequestSchema<LoginRequest>
+{
+    static constexpr FieldSpec<LoginRequest> fields[] = {
+        requestField("email", &LoginRequest::email),
+        requestField("password", &LoginRequest::password)};
+};
+
+template <>
+struct RequestSchema<AddFlightRequest>
+{
+    static constexpr FieldSpec<AddFlightRequest> fields[] = {
+        requestField("flight_number", &AddFlightRequest::flightNumber),
+        requestField("destination", &AddFlightRequest::destination),
+        requestField("departure_date", &AddFlightRequest::departureDate),
+        requestField("total_seats", &AddFlightRequest::totalSeats),
+        requestField("class_type", &AddFlightRequest::classType),
+        requestField("price", &AddFlightRequest::price)};
+};
+
+template <>
+struct RequestSchema<BookingRequest>
+{
+    static constexpr FieldSpec<BookingRequest> fields[] = {
+        requestField("flight_id", &BookingRequest::flightId),
+        requestField("passenger_name", &BookingRequest::passengerName),
+        requestField("passenger_email", &BookingRequest::passengerEmail),
+        requestField("seat_number", &BookingRequest::seatNumber)};
+};
+
+template <>
+struct RequestSchema<AssignSeatsRequest>
+{
+    static constexpr FieldSpec<AssignSeatsRequest> fields[] = {
+        requestField("passenger_name", &AssignSeatsRequest::passengerName),
+        requestField("passenger_email", &AssignSeatsRequest::passengerEmail),
+        requestField("party_size", &AssignSeatsRequest::partySize),
+        requestField("zone", &AssignSeatsRequest::zone, false)};
+};
+
+template <>
+struct RequestSchema<RescheduleRequest>
+{
+    static constexpr FieldSpec<RescheduleRequest> fields[] = {
+        requestField("booking_id", &RescheduleRequest::bookingId),
+        requestField("new_flight_id", &RescheduleRequest::newFlightId),
+        requestField("new_date", &RescheduleRequest::newDate)};
+};
+
+template <typename T>
+class RequestDecoder : public nlohmann::json_sax<nlohmann::json>
+{
+private:
+    static constexpr auto &fields = RequestSchema<T>::fields;
+    static constexpr size_t fieldCount = sizeof(fields) / sizeof(fields[0]);
+    static_assert(fieldCount <= 64, "seen mask holds at most 64 fields");
+
+    T &target;
+    std::string &error;
+    int depth = 0;
+    int current = -1;
+    uint64_t seen = 0;
+
+    bool fail(std::string message)
+    {
+        error = std::move(message);
+        return false;
+    }
+
+    bool typeMismatch()
+    {
+        const FieldSpec<T> &spec = fields[current];
+        switch (spec.type)
+        {
+        case FieldType::String:
+            return fail(std::string("Field '") + spec.name + "' must be a string");
+        case FieldType::Int:
+            return fail(std::string("Field '") + spec.name + "' must be an integer");
+        default:
+            return fail(std::string("Field '") + spec.name + "' must be a number");
+        }
+    }
+
+    // Scalars only matter at the top level of the object and for known keys.
+    bool acceptsScalar(bool &ignore)
+    {
+        ignore = false;
+        if (depth == 0)
+        {
+            return fail("Request body must be a JSON object");
+        }
+        if (depth > 1 || current < 0)
+        {
+            ignore = true;
+        }
+        return true;
+    }
+
+    bool markSeen()
+    {
+        seen |= uint64_t(1) << current;
+        current = -1;
+        return true;
+    }
+
+    bool assignInteger(long long value)
+    {
+        const FieldSpec<T> &spec = fields[current];
+        if (spec.type == FieldType::Number)
+        {
+            target.*spec.numberMember = static_cast<double>(value);
+            return markSeen();
+        }
+        if (spec.type != FieldType::Int)
+        {
+            return typeMismatch();
+        }
+        if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max())
+        {
+            return fail(std::string("Field '") + spec.name + "' is out of range");
+        }
+        target.*spec.intMember = static_cast<int>(value);
+        return markSeen();
+    }
+
+public:
+    RequestDecoder(T &target, std::string &error) : target(target), error(error) {}
+
+    bool null() override
+    {
+        bool ignore;
+        if (!acceptsScalar(ignore))
+            return false;
+        return ignore ? true : typeMismatch();
+    }
+
+    bool boolean(bool) override
+    {
+        bool ignore;
+        if (!acceptsScalar(ignore))
+            return false;
+        return ignore ? true : typeMismatch();
+    }
+
+    bool number_integer(number_integer_t value) override
+    {
+        bool ignore;
+        if (!acceptsScalar(ignore))
+            return false;
+        return ignore ? true : assignInteger(value);
+    }
+
+    bool number_unsigned(number_unsigned_t value) override
+    {
+        bool ignore;
+        if (!acceptsScalar(ignore))
+            return false;
+        if (ignore)
+            return true;
+        if (value > static_cast<number_unsigned_t>(std::numeric_limits<long long>::max()))
+        {
+            return fail(std::string("Field '") + fields[current].name + "' is out of range");
+        }
+        return assignInteger(static_cast<long long>(value));
+    }
+
+    bool number_float(number_float_t value, const string_t &) override
+    {
+        bool ignore;
+        if (!acceptsScalar(ignore))
+            return false;
+        if (ignore)
+            return true;
+        const FieldSpec<T> &spec = fields[current];
+        // 1.0 or 1e2 is still an integer, as it was to the DOM's get<int>()
+        if (spec.type == FieldType::Int && std::isfinite(value) && std::trunc(value) == value)
+        {
+            if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max())
+            {
+                return fail(std::string("Field '") + spec.name + "' is out of range");
+            }
+            target.*spec.intMember = static_cast<int>(value);
+            return markSeen();
+        }
+        if (spec.type != FieldType::Number)
+        {
+            return typeMismatch();
+        }
+        target.*spec.numberMember = value;
+        return markSeen();
+    }
+
+    bool string(string_t &value) override
+    {
+        bool ignore;
+        if (!acceptsScalar(ignore))
+            return false;
+        if (ignore)
+            return true;
+        const FieldSpec<T> &spec = fields[current];
+        if (spec.type != FieldType::String)
+        {
+            return typeMismatch();
+        }
+        // The parser hands over its token buffer, so the value is moved, not copied
+        target.*spec.stringMember = std::move(value);
+        return markSeen();
+    }
+
+    bool binary(binary_t &) override
+    {
+        return fail("Request body must be JSON");
+    }
+
+    bool start_object(std::size_t) override
+    {
+        if (depth == 1 && current >= 0)
+        {
+            return typeMismatch();
+        }
+        ++depth;
+        return true;
+    }
+
+    bool key(string_t &name) override
+    {
+        if (depth != 1)
+        {
+            return true;
+        }
+        current = -1;
+        for (size_t i = 0; i < fieldCount; ++i)
+        {
+            if (name == fields[i].name)
+            {
+                current = static_cast<int>(i);
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool end_object() override
+    {
+        --depth;
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        if (depth == 0)
+        {
+            return fail("Request body must be a JSON object");
+        }
+        if (depth == 1 && current >= 0)
+        {
+            return typeMismatch();
+        }
+        ++depth;
+        return true;
+    }
+
+    bool end_array() override
+    {
+        --depth;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &) override
+    {
+        return fail("Malformed JSON at byte " + std::to_string(position));
+    }
+
+    bool finish()
+    {
+        for (size_t i = 0; i < fieldCount; ++i)
+        {
+            if (fields[i].required && !(seen & (uint64_t(1) << i)))
+            {
+                return fail(std::string("Missing field '") + fields[i].name + "'");
+            }
+        }
+        return true;
+    }
+};
+
+// Decodes `body` into `request`. On failure returns false and leaves a client-facing
+// description of the problem in `error`, suitable for a 400 response.
+template <typename T>
+bool decodeRequest(const std::string &body, T &request, std::string &error)
+{
+    RequestDecoder<T> decoder(request, error);
+    if (!nlohmann::json::sax_parse(body, &decoder))
+    {
+        if (error.empty())
+        {
+            error = "Malformed JSON";
+        }
+        return false;
+    }
+    return decoder.finish();
+}
+
+// Response bodies. The fixed-shape ones are precomputed with the same key order
+// nlohmann's dump() produced, so clients see byte-identical payloads. Assigning
+// one to res.body still copies it (a single allocation of under 100 bytes): the
+// body has to be a string the response owns, because the idempotency store, the
+// traffic capture and compression all read res.body after the handler returns.
+// codec_bench reports that copy next to the json{}.dump() it replaced.
+class JsonResponse
+{
+public:
+    static inline const std::string registrationSucceeded =
+        R"({"message":"Registration successful","success":true})";
+    static inline const std::string registrationFailed =
+        R"({"message":"Registration failed","success":false})";
+    static inline const std::string loginSucceeded =
+        R"({"message":"Login successful","success":true})";
+    static inline const std::string loginFailed =
+        R"({"message":"Invalid email or password","success":false})";
+    static inline const std::string flightAdded =
+        R"({"message":"Flight added successfully","success":true})";
+    static inline const std::string flightAddFailed =
+        R"({"message":"Failed to add flight","success":false})";
+    static inline const std::string bookingSucceeded =
+        R"({"message":"Flight booked successfully","success":true})";
+    static inline const std::string bookingFailed =
+        R"({"message":"Failed to book flight. Seat may no longer be available.","success":false})";
+    static inline const std::string cancelSucceeded =
+        R"({"message":"Booking cancelled successfully","success":true})";
+    static inline const std::string cancelFailed =
+        R"({"message":"Failed to cancel booking","success":false})";
+    static inline const std::string rescheduleSucceeded =
+        R"({"message":"Flight rescheduled successfully","success":true})";
+    static inline const std::string rescheduleFailed =
+        R"({"message":"Failed to reschedule flight","success":false})";
+    static inline const std::string flightNotFound =
+        R"({"message":"Flight not found","success":false})";
+    static inline const std::string noAdjacentSeats =
+        R"({"message":"No block of adjacent seats available","success":false})";
+    static inline const std::string idempotencyKeyTooLong =
+        R"({"message":"Idempotency-Key must be at most 255 characters","success":false})";
+    static inline const std::string idempotencyKeyReused =
+        R"({"message":"Idempotency-Key was already used for a different request","success":false})";
+    static inline const std::string idempotencyKeyInProgress =
+        R"({"message":"A request with this Idempotency-Key is still in progress","success":false})";
+    static inline const std::string rateLimited =
+        R"({"message":"Too many requests","success":false})";
+
+    // {"message":"<prefix><detail>","success":<success>}
+    static void writeMessage(std::string &out, bool success, std::string_view prefix, std::string_view detail = {})
+    {
+        out.clear();
+        out.reserve(32 + prefix.size() + detail.size());
+        out += R"({"message":")";
+        appendJsonEscaped(out, prefix);
+        appendJsonEscaped(out, detail);
+        out += success ? R"(","success":true})" : R"(","success":false})";
+    }
+
+    // {"error":"<prefix><detail>"}
+    static void writeError(std::string &out, std::string_view prefix, std::string_view detail = {})
+    {
+        out.clear();
+        out.reserve(16 + prefix.size() + detail.size());
+        out += R"({"error":")";
+        appendJsonEscaped(out, prefix);
+        appendJsonEscaped(out, detail);
+        out += R"("})";
+    }
+
+    static void writeIntArray(std::string &out, const std::vector<int> &values)
+    {
+        out.clear();
+        out.reserve(2 + values.size() * 4);
+        out += '[';
+        char buffer[16];
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            if (i)
+            {
+                out += ',';
+            }
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), values[i]);
+            out.append(buffer, result.ptr);
+        }
+        out += ']';
+    }
+};
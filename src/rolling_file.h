@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <utility>
+
+// Append-only file rotated by size: flight.log -> flight.log.1 -> ... ->
+// flight.log.<maxFiles>, oldest discarded; with maxFiles 0 the live file is
+// truncated in place instead. Every file starts with `header` when it is
+// created. Writes are buffered until flush(), so the owner decides how much
+// goes out per syscall. Not synchronised; the owner serialises calls.
+class RollingFile
+{
+private:
+    std::string path;
+    size_t maxBytes = 0;
+    int maxFiles = 0;
+    std::string header;
+    std::FILE *file = nullptr;
+    size_t bytes = 0;
+
+    bool reopen(bool truncate = false)
+    {
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty())
+        {
+            std::error_code ec;
+            std::filesystem::create_directories(parent, ec);
+        }
+        file = std::fopen(path.c_str(), truncate ? "wb" : "ab");
+        bytes = 0;
+        if (!file)
+        {
+            return false;
+        }
+        std::fseek(file, 0, SEEK_END);
+        bytes = static_cast<size_t>(std::ftell(file));
+        if (bytes == 0 && !header.empty())
+        {
+            bytes = std::fwrite(header.data(), 1, header.size(), file);
+        }
+        return true;
+    }
+
+public:
+    RollingFile() = default;
+    RollingFile(const RollingFile &) = delete;
+    RollingFile &operator=(const RollingFile &) = delete;
+
+    ~RollingFile()
+    {
+        close();
+    }
+
+    // Opens `filePath` for appending, creating its directory if needed
+    bool open(const std::string &filePath, size_t maxFileBytes, int keepFiles, std::string fileHeader = {})
+    {
+        close();
+        path = filePath;
+        maxBytes = maxFileBytes;
+        maxFiles = keepFiles;
+        header = std::move(fileHeader);
+        return reopen();
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    // Bytes in the live file, header included
+    size_t size() const { return bytes; }
+
+    void write(const char *data, size_t length)
+    {
+        if (!file)
+        {
+            return;
+        }
+        bytes += std::fwrite(data, 1, length, file);
+        if (bytes >= maxBytes)
+        {
+            rotate();
+        }
+    }
+
+    void flush()
+    {
+        if (file)
+        {
+            std::fflush(file);
+        }
+    }
+
+    // Shifts the live file to .1 (and older ones along) and starts a new one
+    void rotate()
+    {
+        close();
+        if (maxFiles <= 0)
+        {
+            reopen(true);
+            return;
+        }
+        std::error_code ec;
+        std::filesystem::remove(path + "." + std::to_string(maxFiles), ec);
+        for (int i = maxFiles - 1; i >= 1; --i)
+        {
+            std::filesystem::rename(path + "." + std::to_string(i), path + "." + std::to_string(i + 1), ec);
+        }
+        std::filesystem::rename(path, path + ".1", ec);
+        reopen();
+    }
+
+    void close()
+    {
+        if (file)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// Path parameters captured by a route, in pattern order. Values are views into
+// the request path, so they are only valid while the request is.
+class RouteParams
+{
+public:
+    static constexpr size_t maxParams = 4;
+
+private:
+    std::string_view values[maxParams];
+    int64_t integers[maxParams] = {};
+    size_t count = 0;
+
+    template <typename>
+    friend class Router;
+
+public:
+    size_t size() const { return count; }
+
+    std::string_view string(size_t index) const { return values[index]; }
+
+    // Only meaningful for {name:int} parameters
+    int64_t integer(size_t index) const { return integers[index]; }
+
+    // An {name:int} parameter that also fits in an int; false if it does not
+    bool integer(size_t index, int &out) const
+    {
+        if (integers[index] < INT_MIN || integers[index] > INT_MAX)
+        {
+            return false;
+        }
+        out = static_cast<int>(integers[index]);
+        return true;
+    }
+};
+
+// Segment trie over route patterns such as "/api/flights/{id:int}/seats". A
+// segment is a literal, {name:int} (unsigned decimal digits; digits that overflow
+// a 64-bit integer do not match) or {name} (any non-empty segment). Matching walks
+// the request path one segment at a time as string_views, trying literal children
+// before integer and then string parameters, so the cost depends on the path's
+// depth rather than on how many routes are registered.
+template <typename Handler>
+class Router
+{
+private:
+    enum class Method
+    {
+        Get,
+        Post,
+        Put,
+        Delete,
+        Patch
+    };
+    static constexpr size_t methodCount = 5;
+
+    struct Node
+    {
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> literals;
+        std::unique_ptr<Node> integerChild;
+        std::unique_ptr<Node> stringChild;
+        Handler handlers[methodCount];
+        bool hasHandler[methodCount] = {};
+    };
+
+    Node root;
+
+    static int methodIndex(std::string_view method)
+    {
+        if (method == "GET" || method == "HEAD")
+            return static_cast<int>(Method::Get);
+        if (method == "POST")
+            return static_cast<int>(Method::Post);
+        if (method == "PUT")
+            return static_cast<int>(Method::Put);
+        if (method == "DELETE")
+            return static_cast<int>(Method::Delete);
+        if (method == "PATCH")
+            return static_cast<int>(Method::Patch);
+        return -1;
+    }
+
+    // Splits off the segment after the leading '/' of `path`; false at the end
+    static bool nextSegment(std::string_view &path, std::string_view &segment)
+    {
+        if (path.empty() || path[0] != '/')
+        {
+            return false;
+        }
+        path.remove_prefix(1);
+        size_t slash = path.find('/');
+        segment = path.substr(0, slash);
+        path.remove_prefix(slash == std::string_view::npos ? path.size() : slash);
+        return true;
+    }
+
+    static bool parseInteger(std::string_view text, int64_t &value)
+    {
+        // from_chars would take a leading '-', but no ID is negative
+        if (text.empty() || text[0] < '0' || text[0] > '9')
+        {
+            return false;
+        }
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc() && end == text.data() + text.size();
+    }
+
+    void add(Method method, const std::string &pattern, Handler handler)
+    {
+        Node *node = &root;
+        std::string_view rest = pattern;
+        std::string_view segment;
+        size_t params = 0;
+        while (nextSegment(rest, segment))
+        {
+            std::unique_ptr<Node> *child = nullptr;
+            if (segment.size() >= 2 && segment.front() == '{' && segment.back() == '}')
+            {
+                if (++params > RouteParams::maxParams)
+                {
+                    throw std::invalid_argument("Too many parameters in route " + pattern);
+                }
+                bool isInteger = segment.size() > 6 && segment.substr(segment.size() - 5) == ":int}";
+                child = isInteger ? &node->integerChild : &node->stringChild;
+            }
+            else
+            {
+                for (auto &[literal, literalChild] : node->literals)
+                {
+                    if (literal == segment)
+                    {
+                        child = &literalChild;
+                        break;
+                    }
+                }
+                if (!child)
+                {
+                    node->literals.emplace_back(std::string(segment), nullptr);
+                    child = &node->literals.back().second;
+                }
+            }
+            if (!*child)
+            {
+                *child = std::make_unique<Node>();
+            }
+            node = child->get();
+        }
+        node->handlers[static_cast<size_t>(method)] = std::move(handler);
+        node->hasHandler[static_cast<size_t>(method)] = true;
+    }
+
+    static const Handler *match(const Node &node, int method, std::string_view path, RouteParams &params)
+    {
+        std::string_view segment;
+        if (!nextSegment(path, segment))
+        {
+            return node.hasHandler[method] ? &node.handlers[method] : nullptr;
+        }
+
+        for (const auto &[literal, child] : node.literals)
+        {
+            if (literal == segment)
+            {
+                if (const Handler *handler = match(*child, method, path, params))
+                    return handler;
+                break;
+            }
+        }
+
+        size_t index = params.count;
+        if (node.integerChild && parseInteger(segment, params.integers[index]))
+        {
+            params.values[index] = segment;
+            params.count = index + 1;
+            if (const Handler *handler = match(*node.integerChild, method, path, params))
+                return handler;
+            params.count = index;
+        }
+
+        if (node.stringChild && !segment.empty())
+        {
+            params.values[index] = segment;
+            params.integers[index] = 0;
+            params.count = index + 1;
+            if (const Handler *handler = match(*node.stringChild, method, path, params))
+                return handler;
+            params.count = index;
+        }
+        return nullptr;
+    }
+
+public:
+    void Get(const std::string &pattern, Handler handler) { add(Method::Get, pattern, std::move(handler)); }
+    void Post(const std::string &pattern, Handler handler) { add(Method::Post, pattern, std::move(handler)); }
+    void Put(const std::string &pattern, Handler handler) { add(Method::Put, pattern, std::move(handler)); }
+    void Delete(const std::string &pattern, Handler handler) { add(Method::Delete, pattern, std::move(handler)); }
+    void Patch(const std::string &pattern, Handler handler) { add(Method::Patch, pattern, std::move(handler)); }
+
+    // The handler registered for `method` and `path`, or nullptr. `path` must not
+    // include the query string.
+    const Handler *match(std::string_view method, std::string_view path, RouteParams &params) const
+    {
+        int index = methodIndex(method);
+        params.count = 0;
+        if (index < 0)
+        {
+            return nullptr;
+        }
+        return match(root, index, path, params);
+    }
+};
@@ -0,0 +1,535 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "seat_map.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// Seat occupancy shared by the pre-fork workers: one bit per seat (set = taken by
+// a CONFIRMED booking) in an anonymous MAP_SHARED mapping that the supervisor
+// creates before forking, so every worker sees the same words. Bits are claimed
+// with fetch_or before the booking is written to SQLite, which makes two workers
+// racing for one seat resolve in shared memory instead of both reaching the
+// database. SQLite stays the source of truth: a failed write releases its claim,
+// and the supervisor reloads the bits from the bookings table after a worker
+// crash, since a worker can die between claiming a seat and committing it.
+//
+// Every claim or release and the SQLite write it belongs to run inside an
+// Update. The reload first stops new Updates in all workers and waits for the
+// ones in progress, so it never overwrites a claim whose write is still pending.
+//
+// The region also holds the analytics counters: active bookings and revenue per
+// flight, and bookings made per day. The worker that commits a change applies
+// it here with atomic adds, so every worker's analytics see it without reading
+// SQLite; only the supervisor's load and reload rebuild them from the tables.
+class SeatInventory
+{
+public:
+    static constexpr int maxSeatsPerFlight = 1024;
+
+    enum class Claim
+    {
+        Claimed,  // the seat was free and is now held by the caller
+        Taken,      // another booking holds it
+        NoSuchSeat, // the flight has no seat with that number
+        Untracked   // flight or seat not in shared memory; ask SQLite
+    };
+
+private:
+    static constexpr int wordsPerFlight = maxSeatsPerFlight / 64;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared seat bits need lock-free 64-bit atomics");
+    static_assert(std::atomic<int32_t>::is_always_lock_free, "shared slot keys need lock-free 32-bit atomics");
+
+    static constexpr size_t daySlotCount = 4096; // about eleven years of booking days
+
+    struct alignas(64) Control
+    {
+        std::atomic<uint32_t> reloading;
+        std::atomic<uint64_t> bookingChanges;
+    };
+
+    // Updates a worker has in progress; each on its own cache line
+    struct alignas(64) WorkerGate
+    {
+        std::atomic<uint32_t> inFlight;
+    };
+
+    // Open-addressed by flight ID; a slot is claimed by CAS on flightId and never freed
+    struct alignas(64) FlightSlot
+    {
+        std::atomic<int32_t> flightId;
+        std::atomic<int32_t> seatCount;
+        std::atomic<uint64_t> taken[wordsPerFlight];
+        std::atomic<int32_t> activeBookings; // not CANCELLED, as BookingAnalytics counts them
+        std::atomic<int64_t> priceCents;
+        std::atomic<int64_t> revenueCents;
+    };
+
+    // Bookings made on one day (yyyymmdd), open-addressed; 0 marks a free slot
+    struct DaySlot
+    {
+        std::atomic<int32_t> day;
+        std::atomic<int32_t> bookings;
+    };
+
+    void *region = nullptr;
+    size_t regionBytes = 0;
+    Control *control = nullptr;
+    WorkerGate *gates = nullptr;
+    int gateCount = 0;
+    FlightSlot *slots = nullptr;
+    size_t slotCount = 0;
+    DaySlot *days = nullptr;
+    int worker = -1; // this process's gate; set in each worker after fork()
+
+    FlightSlot *find(int flightId) const
+    {
+        if (!slots || flightId <= 0)
+        {
+            return nullptr;
+        }
+        for (size_t probe = 0; probe < slotCount; ++probe)
+        {
+            FlightSlot &slot = slots[(static_cast<size_t>(flightId) + probe) % slotCount];
+            int32_t id = slot.flightId.load(std::memory_order_acquire);
+            if (id == flightId)
+                return &slot;
+            if (id == 0)
+                return nullptr;
+        }
+        return nullptr;
+    }
+
+    FlightSlot *seatWord(int flightId, int seatNumber, std::atomic<uint64_t> *&word, uint64_t &bit) const
+    {
+        if (seatNumber < 1 || seatNumber > maxSeatsPerFlight)
+        {
+            return nullptr;
+        }
+        FlightSlot *slot = find(flightId);
+        if (slot)
+        {
+            word = &slot->taken[(seatNumber - 1) / 64];
+            bit = uint64_t(1) << ((seatNumber - 1) % 64);
+        }
+        return slot;
+    }
+
+public:
+    SeatInventory() = default;
+    SeatInventory(const SeatInventory &) = delete;
+    SeatInventory &operator=(const SeatInventory &) = delete;
+
+    ~SeatInventory()
+    {
+#if defined(__linux__)
+        if (region)
+        {
+            munmap(region, regionBytes);
+        }
+#endif
+    }
+
+    // Maps room for `flights` flights shared by `workers` worker processes. Must
+    // run before fork(); false if shared memory is unavailable (or not on Linux).
+    bool create(size_t flights, int workers)
+    {
+#if defined(__linux__)
+        if (region || flights == 0 || workers <= 0)
+        {
+            return false;
+        }
+        regionBytes = sizeof(Control) + workers * sizeof(WorkerGate) + flights * sizeof(FlightSlot) +
+                      daySlotCount * sizeof(DaySlot);
+        void *mapping = mmap(nullptr, regionBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            return false;
+        }
+        region = mapping;
+        char *bytes = static_cast<char *>(region);
+        control = new (bytes) Control();
+        control->reloading.store(0, std::memory_order_relaxed);
+        control->bookingChanges.store(0, std::memory_order_relaxed);
+        gates = reinterpret_cast<WorkerGate *>(bytes + sizeof(Control));
+        gateCount = workers;
+        for (int i = 0; i < gateCount; ++i)
+        {
+            new (&gates[i]) WorkerGate();
+            gates[i].inFlight.store(0, std::memory_order_relaxed);
+        }
+        slots = reinterpret_cast<FlightSlot *>(bytes + sizeof(Control) + workers * sizeof(WorkerGate));
+        slotCount = flights;
+        for (size_t i = 0; i < slotCount; ++i)
+        {
+            new (&slots[i]) FlightSlot();
+            slots[i].flightId.store(0, std::memory_order_relaxed);
+            slots[i].seatCount.store(0, std::memory_order_relaxed);
+            for (auto &word : slots[i].taken)
+                word.store(0, std::memory_order_relaxed);
+            slots[i].activeBookings.store(0, std::memory_order_relaxed);
+            slots[i].priceCents.store(0, std::memory_order_relaxed);
+            slots[i].revenueCents.store(0, std::memory_order_relaxed);
+        }
+        days = reinterpret_cast<DaySlot *>(reinterpret_cast<char *>(slots) + flights * sizeof(FlightSlot));
+        for (size_t i = 0; i < daySlotCount; ++i)
+        {
+            new (&days[i]) DaySlot();
+            days[i].day.store(0, std::memory_order_relaxed);
+            days[i].bookings.store(0, std::memory_order_relaxed);
+        }
+        return true;
+#else
+        (void)flights;
+        (void)workers;
+        return false;
+#endif
+    }
+
+    bool active() const { return slots != nullptr; }
+
+    // Called in each worker after fork(), with its index
+    void attachWorker(int index)
+    {
+        worker = index >= 0 && index < gateCount ? index : -1;
+    }
+
+    // Scope of one change to the bits plus the SQLite write it belongs to. Waits
+    // while the supervisor is reloading. Must not be nested on one thread.
+    class Update
+    {
+    private:
+        std::atomic<uint32_t> *inFlight = nullptr;
+
+    public:
+        explicit Update(SeatInventory *inventory)
+        {
+            if (!inventory || inventory->worker < 0)
+            {
+                return;
+            }
+            inFlight = &inventory->gates[inventory->worker].inFlight;
+            const std::atomic<uint32_t> &reloading = inventory->control->reloading;
+            for (;;)
+            {
+                while (reloading.load(std::memory_order_acquire))
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                // Paired with beginReload(): either it sees this count, or this sees its flag
+                inFlight->fetch_add(1, std::memory_order_seq_cst);
+                if (!reloading.load(std::memory_order_seq_cst))
+                {
+                    return;
+                }
+                inFlight->fetch_sub(1, std::memory_order_seq_cst);
+            }
+        }
+
+        ~Update()
+        {
+            if (inFlight)
+            {
+                inFlight->fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        Update(const Update &) = delete;
+        Update &operator=(const Update &) = delete;
+    };
+
+    // Supervisor: holds new Updates in every worker and waits up to `timeoutMs`
+    // for those in progress. `lostWorker` died mid-update, so its count is dropped.
+    // False on timeout; the reload then goes ahead, and SQLite still rejects any
+    // booking that a stale bit lets through.
+    bool beginReload(int lostWorker, int timeoutMs)
+    {
+        if (!control)
+        {
+            return true;
+        }
+        control->reloading.store(1, std::memory_order_seq_cst);
+        if (lostWorker >= 0 && lostWorker < gateCount)
+        {
+            gates[lostWorker].inFlight.store(0, std::memory_order_seq_cst);
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        for (int i = 0; i < gateCount; ++i)
+        {
+            while (gates[i].inFlight.load(std::memory_order_seq_cst) != 0)
+            {
+                if (std::chrono::steady_clock::now() >= deadline)
+                {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        return true;
+    }
+
+    void endReload()
+    {
+        if (control)
+        {
+            control->reloading.store(0, std::memory_order_release);
+        }
+    }
+
+    // Starts tracking a flight of `seatCount` seats; false if the region is full.
+    // Only the first maxSeatsPerFlight seats get bits.
+    bool addFlight(int flightId, int seatCount, double price = 0.0)
+    {
+        if (!slots || flightId <= 0)
+        {
+            return false;
+        }
+        for (size_t probe = 0; probe < slotCount; ++probe)
+        {
+            FlightSlot &slot = slots[(static_cast<size_t>(flightId) + probe) % slotCount];
+            int32_t expected = 0;
+            if (slot.flightId.compare_exchange_strong(expected, flightId, std::memory_order_acq_rel) ||
+                expected == flightId)
+            {
+                slot.priceCents.store(std::llround(price * 100), std::memory_order_relaxed);
+                slot.seatCount.store(seatCount, std::memory_order_release);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Counts `delta` bookings as made active (or, negative, as cancelled or moved
+    // away) on a flight; false if the flight is not tracked
+    bool addBookings(int flightId, int delta)
+    {
+        FlightSlot *slot = find(flightId);
+        if (!slot)
+        {
+            return false;
+        }
+        slot->activeBookings.fetch_add(delta, std::memory_order_relaxed);
+        slot->revenueCents.fetch_add(delta * slot->priceCents.load(std::memory_order_relaxed),
+                                     std::memory_order_relaxed);
+        return true;
+    }
+
+    // Counts `count` bookings made on `day` (yyyymmdd); false once every day slot
+    // is taken by another day
+    bool addDayBookings(int32_t day, int count)
+    {
+        if (!days || day == 0)
+        {
+            return false;
+        }
+        for (size_t probe = 0; probe < daySlotCount; ++probe)
+        {
+            DaySlot &slot = days[(static_cast<uint32_t>(day) + probe) % daySlotCount];
+            int32_t expected = 0;
+            if (slot.day.compare_exchange_strong(expected, day, std::memory_order_acq_rel) || expected == day)
+            {
+                slot.bookings.fetch_add(count, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct FlightCounters
+    {
+        int flightId;
+        int activeBookings;
+        int64_t revenueCents;
+    };
+
+    // Counters of every tracked flight. Not a snapshot: a change landing during the
+    // copy may be half in it, and its noteBookingChange() makes the reader copy again.
+    void flightCounters(std::vector<FlightCounters> &counters) const
+    {
+        counters.clear();
+        for (size_t i = 0; i < slotCount; ++i)
+        {
+            int32_t id = slots[i].flightId.load(std::memory_order_acquire);
+            if (id != 0)
+            {
+                counters.push_back({id, slots[i].activeBookings.load(std::memory_order_relaxed),
+                                    slots[i].revenueCents.load(std::memory_order_relaxed)});
+            }
+        }
+    }
+
+    // (yyyymmdd, bookings made that day) for every day with a booking
+    void dayCounters(std::vector<std::pair<int32_t, int32_t>> &counters) const
+    {
+        counters.clear();
+        for (size_t i = 0; days && i < daySlotCount; ++i)
+        {
+            int32_t day = days[i].day.load(std::memory_order_acquire);
+            if (day != 0)
+            {
+                counters.emplace_back(day, days[i].bookings.load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    // Replaces the analytics counters with counts from SQLite. Only at startup or
+    // between beginReload() and endReload(), like reset().
+    void resetCounters(const std::vector<std::pair<int, int>> &activeBookings,
+                       const std::vector<std::pair<int32_t, int32_t>> &dayBookings)
+    {
+        for (size_t i = 0; i < slotCount; ++i)
+        {
+            slots[i].activeBookings.store(0, std::memory_order_relaxed);
+            slots[i].revenueCents.store(0, std::memory_order_relaxed);
+        }
+        for (const auto &[flightId, count] : activeBookings)
+        {
+            addBookings(flightId, count);
+        }
+        for (size_t i = 0; days && i < daySlotCount; ++i)
+        {
+            days[i].day.store(0, std::memory_order_relaxed);
+            days[i].bookings.store(0, std::memory_order_relaxed);
+        }
+        for (const auto &[day, count] : dayBookings)
+        {
+            addDayBookings(day, count);
+        }
+    }
+
+    // Committed booking and flight changes across all workers, bumped after the
+    // counters above. A worker whose aggregates were copied from them at an older
+    // count has missed a change.
+    void noteBookingChange()
+    {
+        if (control)
+        {
+            control->bookingChanges.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    uint64_t bookingChanges() const
+    {
+        return control ? control->bookingChanges.load(std::memory_order_acquire) : 0;
+    }
+
+    // Replaces a flight's bits with the seats SQLite has as taken. Only at
+    // startup or between beginReload() and endReload().
+    void reset(int flightId, const std::vector<int> &takenSeats)
+    {
+        FlightSlot *slot = find(flightId);
+        if (!slot)
+        {
+            return;
+        }
+        uint64_t words[wordsPerFlight] = {};
+        for (int seat : takenSeats)
+        {
+            if (seat >= 1 && seat <= maxSeatsPerFlight)
+                words[(seat - 1) / 64] |= uint64_t(1) << ((seat - 1) % 64);
+        }
+        for (int i = 0; i < wordsPerFlight; ++i)
+        {
+            slot->taken[i].store(words[i], std::memory_order_release);
+        }
+    }
+
+    Claim claim(int flightId, int seatNumber)
+    {
+        FlightSlot *slot = find(flightId);
+        if (!slot)
+        {
+            return Claim::Untracked;
+        }
+        // A bit past the last seat would show up as a taken seat that does not exist
+        if (seatNumber < 1 || seatNumber > slot->seatCount.load(std::memory_order_acquire))
+        {
+            return Claim::NoSuchSeat;
+        }
+        std::atomic<uint64_t> *word;
+        uint64_t bit;
+        if (!seatWord(flightId, seatNumber, word, bit))
+        {
+            return Claim::Untracked;
+        }
+        return (word->fetch_or(bit, std::memory_order_acq_rel) & bit) ? Claim::Taken : Claim::Claimed;
+    }
+
+    void release(int flightId, int seatNumber)
+    {
+        std::atomic<uint64_t> *word;
+        uint64_t bit;
+        if (seatWord(flightId, seatNumber, word, bit))
+        {
+            word->fetch_and(~bit, std::memory_order_acq_rel);
+        }
+    }
+
+    // Free seat numbers; false if the flight is not tracked or has seats beyond
+    // maxSeatsPerFlight, which only SQLite knows about
+    bool freeSeats(int flightId, std::vector<int> &seats) const
+    {
+        FlightSlot *slot = find(flightId);
+        int lastSeat = slot ? slot->seatCount.load(std::memory_order_acquire) : 0;
+        if (!slot || lastSeat > maxSeatsPerFlight)
+        {
+            return false;
+        }
+        seats.clear();
+        for (int i = 0; i * 64 < lastSeat; ++i)
+        {
+            uint64_t taken = slot->taken[i].load(std::memory_order_acquire);
+            for (int b = 0; b < 64 && i * 64 + b < lastSeat; ++b)
+            {
+                if (!(taken & (uint64_t(1) << b)))
+                    seats.push_back(i * 64 + b + 1);
+            }
+        }
+        return true;
+    }
+
+    // Taken seat numbers; false if the flight is not tracked or has seats beyond
+    // maxSeatsPerFlight
+    bool takenSeats(int flightId, std::vector<int> &seats) const
+    {
+        FlightSlot *slot = find(flightId);
+        if (!slot || slot->seatCount.load(std::memory_order_acquire) > maxSeatsPerFlight)
+        {
+            return false;
+        }
+        seats.clear();
+        for (int i = 0; i < wordsPerFlight; ++i)
+        {
+            uint64_t taken = slot->taken[i].load(std::memory_order_acquire);
+            while (taken)
+            {
+                int b = lowestSetBit(taken);
+                taken &= taken - 1;
+                seats.push_back(i * 64 + b + 1);
+            }
+        }
+        return true;
+    }
+
+    size_t trackedFlights() const
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < slotCount; ++i)
+        {
+            count += slots[i].flightId.load(std::memory_order_relaxed) != 0;
+        }
+        return count;
+    }
+};
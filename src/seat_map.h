@@ -0,0 +1,309 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit; `mask` must be non-zero
+inline int lowestSetBit(uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+struct SeatZone
+{
+    int firstRow; // 1-based, inclusive
+    int lastRow;
+    std::string name;
+};
+
+// Cabin layout for one flight: `rows` rows of the seat letters in `letters`, where
+// '|' marks an aisle ("ABC|DEF"). Seat numbers run row by row from 1, so seat 1 is
+// 1A and seat N is the last seat of the last row; numbers beyond totalSeats in a
+// partial last row do not exist.
+class SeatLayout
+{
+public:
+    static constexpr int maxSeatsPerRow = 64;
+
+private:
+    int rowCount = 0;
+    int totalSeats = 0;
+    std::string seatLetters;
+    std::vector<SeatZone> zones;
+    int seatsPerRow = 0;
+    std::vector<uint64_t> segments; // one mask per group of seats between aisles
+
+    // Throws std::invalid_argument for a row wider than one occupancy word
+    void index()
+    {
+        int width = 0;
+        for (char c : seatLetters)
+            width += c != '|';
+        if (width > maxSeatsPerRow)
+        {
+            throw std::invalid_argument("Seat layout '" + seatLetters + "' has " + std::to_string(width) +
+                                        " seats per row; at most " + std::to_string(maxSeatsPerRow) +
+                                        " are supported");
+        }
+
+        seatsPerRow = 0;
+        segments.clear();
+        uint64_t segment = 0;
+        for (char c : seatLetters)
+        {
+            if (c == '|')
+            {
+                if (segment)
+                    segments.push_back(segment);
+                segment = 0;
+                continue;
+            }
+            segment |= uint64_t(1) << seatsPerRow;
+            ++seatsPerRow;
+        }
+        if (segment)
+            segments.push_back(segment);
+    }
+
+public:
+    SeatLayout() = default;
+
+    // Rows of more than maxSeatsPerRow seats are rejected here rather than
+    // surfacing later as a party that never fits
+    SeatLayout(int rows, int totalSeats, const std::string &letters, std::vector<SeatZone> zones)
+        : rowCount(rows), totalSeats(totalSeats), seatLetters(letters), zones(std::move(zones))
+    {
+        index();
+    }
+
+    // Narrow-body up to 60 seats, 3-3 up to 200, 3-4-3 above
+    static SeatLayout forCapacity(int totalSeats, const std::string &classType)
+    {
+        std::string letters = totalSeats <= 60 ? "AB|CD" : totalSeats <= 200 ? "ABC|DEF"
+                                                                             : "ABC|DEFG|HJK";
+        int perRow = 0;
+        for (char c : letters)
+            perRow += c != '|';
+        int rows = (totalSeats + perRow - 1) / perRow;
+        return SeatLayout(rows, totalSeats, letters, {{1, rows, classType}});
+    }
+
+    // Zones as stored in seat_layouts.class_zones: "1-3:First,4-30:Economy"
+    static std::vector<SeatZone> parseZones(const std::string &text)
+    {
+        std::vector<SeatZone> parsed;
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find(',', start);
+            std::string item = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            size_t dash = item.find('-');
+            size_t colon = item.find(':');
+            if (dash != std::string::npos && colon != std::string::npos && dash < colon)
+            {
+                parsed.push_back({std::atoi(item.substr(0, dash).c_str()),
+                                  std::atoi(item.substr(dash + 1, colon - dash - 1).c_str()),
+                                  item.substr(colon + 1)});
+            }
+            if (end == std::string::npos)
+                break;
+            start = end + 1;
+        }
+        return parsed;
+    }
+
+    static std::string formatZones(const std::vector<SeatZone> &zones)
+    {
+        std::string text;
+        for (const SeatZone &zone : zones)
+        {
+            if (!text.empty())
+                text += ',';
+            text += std::to_string(zone.firstRow) + "-" + std::to_string(zone.lastRow) + ":" + zone.name;
+        }
+        return text;
+    }
+
+    bool valid() const { return rowCount > 0 && seatsPerRow > 0 && seatsPerRow <= maxSeatsPerRow; }
+    int rows() const { return rowCount; }
+    int capacity() const { return totalSeats; }
+    int perRow() const { return seatsPerRow; }
+    const std::string &letters() const { return seatLetters; }
+    const std::vector<SeatZone> &classZones() const { return zones; }
+    const std::vector<uint64_t> &aisleSegments() const { return segments; }
+
+    // Seats that exist in `row` (0-based); only the last row can be partial
+    uint64_t rowMask(int row) const
+    {
+        int seats = totalSeats - row * seatsPerRow;
+        if (seats >= seatsPerRow)
+            return seatsPerRow == 64 ? ~uint64_t(0) : (uint64_t(1) << seatsPerRow) - 1;
+        return seats <= 0 ? 0 : (uint64_t(1) << seats) - 1;
+    }
+
+    bool rowInZone(int row, const std::string &zone) const
+    {
+        if (zone.empty())
+            return true;
+        for (const SeatZone &candidate : zones)
+        {
+            if (candidate.name == zone && row + 1 >= candidate.firstRow && row + 1 <= candidate.lastRow)
+                return true;
+        }
+        return false;
+    }
+
+    int seatNumber(int row, int column) const { return row * seatsPerRow + column + 1; }
+
+    // "12C" for the seat number in this layout
+    std::string label(int seatNumber) const
+    {
+        int row = (seatNumber - 1) / seatsPerRow;
+        int column = (seatNumber - 1) % seatsPerRow;
+        std::string text = std::to_string(row + 1);
+        for (char c : seatLetters)
+        {
+            if (c == '|')
+                continue;
+            if (column-- == 0)
+            {
+                text += c;
+                break;
+            }
+        }
+        return text;
+    }
+};
+
+// Seat occupancy for one flight, one 64-bit word per row (bit = column, set = taken)
+class SeatOccupancy
+{
+private:
+    std::vector<uint64_t> taken;
+    int seatsPerRow;
+
+public:
+    explicit SeatOccupancy(const SeatLayout &layout)
+        : taken(layout.rows(), 0), seatsPerRow(layout.perRow()) {}
+
+    void markTaken(int seatNumber)
+    {
+        if (seatNumber < 1)
+            return;
+        size_t row = static_cast<size_t>((seatNumber - 1) / seatsPerRow);
+        if (row < taken.size())
+            taken[row] |= uint64_t(1) << ((seatNumber - 1) % seatsPerRow);
+    }
+
+    uint64_t row(int index) const { return taken[index]; }
+};
+
+// Finds the best block of `partySize` adjacent free seats. Each row is scanned a
+// word at a time: after folding the free mask with shifted copies of itself, bit c
+// is set iff seats c..c+partySize-1 are all free. Blocks stay within one aisle
+// segment when possible and only cross an aisle if no segment fits the party.
+// Blocks that do not strand a single free seat beside them are preferred, then the
+// frontmost row in the requested zone, then the leftmost seat.
+class SeatAssigner
+{
+private:
+    // Bit c set iff bits c..c+length-1 of `free` are all set
+    static uint64_t runStarts(uint64_t free, int length)
+    {
+        uint64_t runs = free;
+        int covered = 1;
+        while (covered < length)
+        {
+            int step = covered <= length - covered ? covered : length - covered;
+            runs &= runs >> step;
+            covered += step;
+        }
+        return runs;
+    }
+
+    // A block leaves an orphan when exactly one free seat remains between it and
+    // the next taken seat or edge of its segment
+    static bool leavesOrphan(uint64_t free, uint64_t segment, int start, int length)
+    {
+        uint64_t left = start > 0 ? uint64_t(1) << (start - 1) : 0;
+        uint64_t leftTwo = start > 1 ? uint64_t(1) << (start - 2) : 0;
+        int end = start + length;
+        uint64_t right = end < 64 ? uint64_t(1) << end : 0;
+        uint64_t rightTwo = end + 1 < 64 ? uint64_t(1) << (end + 1) : 0;
+        uint64_t open = free & segment;
+        bool orphanLeft = (open & left) && !(open & leftTwo);
+        bool orphanRight = (open & right) && !(open & rightTwo);
+        return orphanLeft || orphanRight;
+    }
+
+    static bool scan(const SeatLayout &layout, const SeatOccupancy &occupancy, int partySize,
+                     const std::string &zone, bool crossAisles, std::vector<int> &seats)
+    {
+        const uint64_t fullRow[1] = {layout.rowMask(0)};
+        const uint64_t *segments = crossAisles ? fullRow : layout.aisleSegments().data();
+        const size_t segmentCount = crossAisles ? 1 : layout.aisleSegments().size();
+
+        int bestRow = -1, bestColumn = -1;
+        bool bestOrphan = true;
+        for (int row = 0; row < layout.rows(); ++row)
+        {
+            if (!layout.rowInZone(row, zone))
+                continue;
+            uint64_t free = ~occupancy.row(row) & layout.rowMask(row);
+            for (size_t s = 0; s < segmentCount; ++s)
+            {
+                uint64_t segment = segments[s];
+                uint64_t starts = runStarts(free & segment, partySize);
+                while (starts)
+                {
+                    int column = lowestSetBit(starts);
+                    starts &= starts - 1;
+                    bool orphan = leavesOrphan(free, segment, column, partySize);
+                    if (bestRow < 0 || (!orphan && bestOrphan))
+                    {
+                        bestRow = row;
+                        bestColumn = column;
+                        bestOrphan = orphan;
+                    }
+                    if (!bestOrphan)
+                        break;
+                }
+                if (bestRow >= 0 && !bestOrphan)
+                    break;
+            }
+            // A clean block in this row beats anything further back
+            if (bestRow >= 0 && !bestOrphan)
+                break;
+        }
+
+        if (bestRow < 0)
+            return false;
+        seats.clear();
+        for (int i = 0; i < partySize; ++i)
+            seats.push_back(layout.seatNumber(bestRow, bestColumn + i));
+        return true;
+    }
+
+public:
+    static bool findBlock(const SeatLayout &layout, const SeatOccupancy &occupancy, int partySize,
+                          const std::string &zone, std::vector<int> &seats)
+    {
+        if (!layout.valid() || partySize < 1 || partySize > layout.perRow())
+            return false;
+        return scan(layout, occupancy, partySize, zone, false, seats) ||
+               (layout.aisleSegments().size() > 1 && scan(layout, occupancy, partySize, zone, true, seats));
+    }
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "compression.h"
+#include "idempotency.h"
+#include "logger.h"
+#include "prefork.h"
+#include "rate_limiter.h"
+#include "tracing.h"
+#include "traffic_capture.h"
+
+// Runtime tunables, read once at startup from FLIGHT_* environment variables.
+struct ServerConfig
+{
+    std::string host = "localhost";
+    int port = 8080;
+    CompressionOptions compression;
+    RateLimitOptions rateLimit;
+    LoggerOptions logging;
+    TracingOptions tracing;
+    CaptureOptions capture;
+    IdempotencyOptions idempotency;
+    PreforkOptions prefork;
+
+    static ServerConfig fromEnvironment()
+    {
+        ServerConfig config;
+        config.host = envString("FLIGHT_HOST", config.host);
+        config.port = static_cast<int>(envNumber("FLIGHT_PORT", config.port));
+
+        config.compression.enabled = envNumber("FLIGHT_GZIP", 1) != 0;
+        config.compression.minBytes = static_cast<size_t>(envNumber("FLIGHT_GZIP_MIN_BYTES", static_cast<double>(config.compression.minBytes)));
+        config.compression.level = static_cast<int>(envNumber("FLIGHT_GZIP_LEVEL", config.compression.level));
+        if (config.compression.level < 1 || config.compression.level > 9)
+        {
+            config.compression.level = 6;
+        }
+
+        config.rateLimit.enabled = envNumber("FLIGHT_RATE_LIMIT", 1) != 0;
+        config.rateLimit.auth.ratePerSecond = envNumber("FLIGHT_AUTH_RATE", config.rateLimit.auth.ratePerSecond);
+        config.rateLimit.auth.burst = envNumber("FLIGHT_AUTH_BURST", config.rateLimit.auth.burst);
+        config.rateLimit.booking.ratePerSecond = envNumber("FLIGHT_BOOKING_RATE", config.rateLimit.booking.ratePerSecond);
+        config.rateLimit.booking.burst = envNumber("FLIGHT_BOOKING_BURST", config.rateLimit.booking.burst);
+        if (config.rateLimit.auth.ratePerSecond <= 0 || config.rateLimit.booking.ratePerSecond <= 0)
+        {
+            config.rateLimit.enabled = false;
+        }
+
+        config.logging.level = parseLogLevel(envString("FLIGHT_LOG_LEVEL", ""), config.logging.level);
+        config.logging.path = envString("FLIGHT_LOG_FILE", config.logging.path);
+        config.logging.maxFileBytes = static_cast<size_t>(envNumber("FLIGHT_LOG_MAX_BYTES", static_cast<double>(config.logging.maxFileBytes)));
+        config.logging.maxFiles = static_cast<int>(envNumber("FLIGHT_LOG_FILES", config.logging.maxFiles));
+
+        config.tracing.sampleRatio = envNumber("FLIGHT_TRACE_SAMPLE", config.tracing.sampleRatio);
+        config.tracing.path = envString("FLIGHT_TRACE_FILE", config.tracing.path);
+
+        config.capture.enabled = envNumber("FLIGHT_CAPTURE", 0) != 0;
+        config.capture.path = envString("FLIGHT_CAPTURE_FILE", config.capture.path);
+
+        config.idempotency.enabled = envNumber("FLIGHT_IDEMPOTENCY", 1) != 0;
+        config.idempotency.ttlSeconds = static_cast<int64_t>(envNumber("FLIGHT_IDEMPOTENCY_TTL", static_cast<double>(config.idempotency.ttlSeconds)));
+        config.idempotency.maxEntries = static_cast<size_t>(envNumber("FLIGHT_IDEMPOTENCY_MAX", static_cast<double>(config.idempotency.maxEntries)));
+
+        // FLIGHT_WORKERS=0 starts one worker per core
+        config.prefork.workers = static_cast<int>(envNumber("FLIGHT_WORKERS", config.prefork.workers));
+        if (config.prefork.workers <= 0)
+        {
+            config.prefork.workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+        config.prefork.inventoryFlights = static_cast<size_t>(envNumber("FLIGHT_INVENTORY_FLIGHTS", static_cast<double>(config.prefork.inventoryFlights)));
+        config.prefork.rateLimitKeys = static_cast<size_t>(envNumber("FLIGHT_RATE_LIMIT_KEYS", static_cast<double>(config.prefork.rateLimitKeys)));
+        return config;
+    }
+
+private:
+    static std::string envString(const char *name, const std::string &fallback)
+    {
+        const char *value = std::getenv(name);
+        return value && *value ? std::string(value) : fallback;
+    }
+
+    static double envNumber(const char *name, double fallback)
+    {
+        const char *value = std::getenv(name);
+        if (!value || !*value)
+        {
+            return fallback;
+        }
+        char *end = nullptr;
+        double parsed = std::strtod(value, &end);
+        return end != value ? parsed : fallback;
+    }
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "json_writer.h"
+#include "rolling_file.h"
+
+struct TracingOptions
+{
+    double sampleRatio = 0.01; // fraction of requests traced; 0 disables tracing
+    std::string path = "traces/flight.trace.json";
+    size_t maxFileBytes = 50 * 1024 * 1024;
+    int maxFiles = 3;
+    uint64_t firstRequestId = 1; // pre-fork workers each start their own range
+    int processId = 1;           // "pid" of every trace event
+};
+
+// One completed span. `name` must be a string literal.
+struct TraceEvent
+{
+    const char *name;
+    int64_t startUs;
+    int64_t durationUs;
+};
+
+// Per-request tracing. The pre-routing hook assigns every request an ID and decides
+// whether to sample it; spans are only recorded on sampled requests, so the cost on
+// the rest is one thread-local flag check per span. Sampled requests are appended to
+// a rolling file in Chrome trace_event array format (open in Perfetto or
+// about:tracing), one track per request.
+class Tracer
+{
+private:
+    static constexpr size_t maxEventsPerRequest = 1024;
+
+    struct ActiveTrace
+    {
+        bool sampled = false;
+        uint64_t requestId = 0;
+        int64_t startUs = 0;
+        int64_t writeStartUs = 0;
+        std::vector<TraceEvent> events;
+    };
+
+    TracingOptions options;
+    uint64_t sampleThreshold = 0;
+    std::atomic<uint64_t> nextRequestId{1};
+    std::mutex fileMutex;
+    RollingFile file;
+    bool fileOpened = false;
+
+    static ActiveTrace &current()
+    {
+        thread_local ActiveTrace trace;
+        return trace;
+    }
+
+    static uint64_t mix(uint64_t x)
+    {
+        // splitmix64 finaliser: spreads sequential IDs uniformly for sampling
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // The array format tolerates a missing closing bracket, so each file is simply
+    // "[" followed by one event per line. A trace left by an earlier run (or an
+    // earlier incarnation of this worker) is rotated out rather than appended to,
+    // since its track IDs restart from the same numbers.
+    bool openFile()
+    {
+        if (!file.open(options.path, options.maxFileBytes, options.maxFiles, "[\n"))
+        {
+            return false;
+        }
+        if (!fileOpened && file.size() > 2)
+        {
+            file.rotate();
+        }
+        fileOpened = true;
+        return file.isOpen();
+    }
+
+    static void appendEvent(std::string &out, const char *name, int pid, uint64_t tid, int64_t ts, int64_t dur)
+    {
+        out += R"({"name":")";
+        out += name;
+        out += R"(","ph":"X","pid":)";
+        out += std::to_string(pid);
+        out += R"(,"tid":)";
+        out += std::to_string(tid);
+        out += R"(,"ts":)";
+        out += std::to_string(ts);
+        out += R"(,"dur":)";
+        out += std::to_string(dur);
+        out += "},\n";
+    }
+
+public:
+    static Tracer &instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    static int64_t nowUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static bool active()
+    {
+        return current().sampled;
+    }
+
+    void configure(const TracingOptions &tracingOptions)
+    {
+        std::lock_guard<std::mutex> lock(fileMutex);
+        options = tracingOptions;
+        double ratio = options.sampleRatio < 0 ? 0 : (options.sampleRatio > 1 ? 1 : options.sampleRatio);
+        sampleThreshold = ratio >= 1.0 ? UINT64_MAX : static_cast<uint64_t>(ratio * 18446744073709551616.0);
+        nextRequestId.store(options.firstRequestId, std::memory_order_relaxed);
+    }
+
+    // Called from pre-routing. Returns the request ID used for X-Request-Id.
+    uint64_t beginRequest()
+    {
+        uint64_t requestId = nextRequestId.fetch_add(1, std::memory_order_relaxed);
+        ActiveTrace &trace = current();
+        trace.sampled = sampleThreshold != 0 && mix(requestId) < sampleThreshold;
+        if (trace.sampled)
+        {
+            trace.requestId = requestId;
+            trace.startUs = nowUs();
+            trace.writeStartUs = 0;
+            trace.events.clear();
+        }
+        return requestId;
+    }
+
+    void record(const char *name, int64_t startUs, int64_t endUs)
+    {
+        ActiveTrace &trace = current();
+        if (trace.events.size() < maxEventsPerRequest)
+        {
+            trace.events.push_back({name, startUs, endUs - startUs});
+        }
+    }
+
+    // Called from post-routing, just before httplib serialises the response.
+    void markResponseWrite()
+    {
+        ActiveTrace &trace = current();
+        if (trace.sampled)
+        {
+            trace.writeStartUs = nowUs();
+        }
+    }
+
+    // Called from the httplib logger, after the response has been written.
+    void endRequest(const std::string &method, const std::string &path, int status)
+    {
+        ActiveTrace &trace = current();
+        if (!trace.sampled)
+        {
+            return;
+        }
+        trace.sampled = false;
+        int64_t endUs = nowUs();
+
+        std::string out;
+        out.reserve(256 + trace.events.size() * 96);
+        out += R"({"name":"thread_name","ph":"M","pid":)";
+        out += std::to_string(options.processId);
+        out += R"(,"tid":)";
+        out += std::to_string(trace.requestId);
+        out += R"(,"args":{"name":"#)";
+        out += std::to_string(trace.requestId);
+        out += ' ';
+        appendJsonEscaped(out, method);
+        out += ' ';
+        appendJsonEscaped(out, path);
+        out += ' ';
+        out += std::to_string(status);
+        out += "\"}},\n";
+
+        appendEvent(out, "request", options.processId, trace.requestId, trace.startUs, endUs - trace.startUs);
+        if (trace.writeStartUs)
+        {
+            appendEvent(out, "response.write", options.processId, trace.requestId, trace.writeStartUs, endUs - trace.writeStartUs);
+        }
+        for (const TraceEvent &event : trace.events)
+        {
+            appendEvent(out, event.name, options.processId, trace.requestId, event.startUs, event.durationUs);
+        }
+
+        std::lock_guard<std::mutex> lock(fileMutex);
+        if (!file.isOpen() && !openFile())
+        {
+            return;
+        }
+        // A sampled request is its own batch
+        file.write(out.data(), out.size());
+        file.flush();
+    }
+};
+
+// Records the enclosing scope as a span on the current request, if it is sampled.
+class TraceSpan
+{
+private:
+    const char *name;
+    int64_t startUs;
+
+public:
+    explicit TraceSpan(const char *name) : name(name), startUs(Tracer::active() ? Tracer::nowUs() : 0) {}
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    ~TraceSpan()
+    {
+        if (startUs && Tracer::active())
+        {
+            Tracer::instance().record(name, startUs, Tracer::nowUs());
+        }
+    }
+};
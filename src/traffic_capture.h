@@ -0,0 +1,320 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "hash.h"
+#include "json_writer.h"
+
+struct CaptureOptions
+{
+    bool enabled = false;
+    std::string path = "requests.jsonl";
+    size_t flushBytes = 64 * 1024;            // wake the writer early once this much is buffered
+    size_t maxPendingBytes = 8 * 1024 * 1024; // lines beyond this are dropped, not queued
+};
+
+// Ends a JSON string token whose opening quote is at `start`; returns the index
+// of the closing quote, or npos if the string is unterminated
+inline size_t jsonStringEnd(std::string_view json, size_t start)
+{
+    for (size_t i = start + 1; i < json.size(); ++i)
+    {
+        if (json[i] == '\\')
+            ++i;
+        else if (json[i] == '"')
+            return i;
+    }
+    return std::string_view::npos;
+}
+
+// Ends the JSON value starting at `start`; returns the index just past it, or
+// npos if it runs off the end. Nested objects and arrays are skipped whole.
+inline size_t jsonValueEnd(std::string_view json, size_t start)
+{
+    if (json[start] == '"')
+    {
+        size_t end = jsonStringEnd(json, start);
+        return end == std::string_view::npos ? end : end + 1;
+    }
+    if (json[start] != '{' && json[start] != '[')
+    {
+        size_t end = json.find_first_of(",}] \t\r\n", start);
+        return end == std::string_view::npos ? json.size() : end;
+    }
+    int depth = 0;
+    for (size_t i = start; i < json.size(); ++i)
+    {
+        if (json[i] == '"')
+        {
+            i = jsonStringEnd(json, i);
+            if (i == std::string_view::npos)
+                return i;
+        }
+        else if (json[i] == '{' || json[i] == '[')
+            ++depth;
+        else if ((json[i] == '}' || json[i] == ']') && --depth == 0)
+            return i + 1;
+    }
+    return std::string_view::npos;
+}
+
+// Replaces the value of every member named `field` in a JSON body, scanning
+// tokens rather than parsing the document. The placeholder keeps the value's
+// type, so a replay is rejected or accepted as the original was: strings become
+// "<replacement>", numbers 0, objects {} and arrays []. true, false and null are
+// left alone.
+inline std::string redactJsonField(std::string_view json, std::string_view field, std::string_view replacement)
+{
+    std::string out;
+    size_t copied = 0;
+    size_t i = json.find('"');
+    while (i != std::string_view::npos)
+    {
+        size_t end = jsonStringEnd(json, i);
+        if (end == std::string_view::npos)
+        {
+            break;
+        }
+        size_t next = json.find_first_not_of(" \t\r\n", end + 1);
+        bool isMember = json.substr(i + 1, end - i - 1) == field && next != std::string_view::npos && json[next] == ':';
+        if (isMember)
+        {
+            size_t value = json.find_first_not_of(" \t\r\n", next + 1);
+            char first = value == std::string_view::npos ? 't' : json[value];
+            if (first != 't' && first != 'f' && first != 'n')
+            {
+                out.append(json.substr(copied, value - copied));
+                if (first == '"')
+                {
+                    out += '"';
+                    out.append(replacement);
+                    out += '"';
+                }
+                else if (first == '{')
+                    out += "{}";
+                else if (first == '[')
+                    out += "[]";
+                else
+                    out += '0';
+                // An unterminated value (a malformed body) is dropped to the end
+                copied = jsonValueEnd(json, value);
+                if (copied == std::string_view::npos)
+                {
+                    copied = json.size();
+                    break;
+                }
+                end = copied - 1;
+            }
+        }
+        i = json.find('"', end + 1);
+    }
+    out.append(json.substr(copied));
+    return out;
+}
+
+// Records each request as one JSON line:
+//   {"ts_us":..,"client":..,"method":..,"path":..,"headers":{..},"body":..,"status":..,"latency_us":..,"response_hash":..}
+// Handler threads append to an in-memory buffer; a background thread writes it out,
+// so capture never puts file I/O on the request path. Only the headers a replay
+// needs to reproduce the response are kept, and passwords are replaced with a
+// placeholder, which replays consistently between /register and /login.
+class TrafficCapture
+{
+public:
+    static constexpr const char *replayedHeaders[] = {"Idempotency-Key", "Accept-Encoding"};
+    static constexpr const char *redactedPassword = "redacted";
+
+private:
+    CaptureOptions options;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::string pending;
+    std::atomic<bool> running{false};
+    std::thread writer;
+    std::FILE *file = nullptr;
+    std::atomic<uint64_t> capturedRequests{0};
+    std::atomic<uint64_t> droppedRequests{0};
+
+    struct RequestClock
+    {
+        int64_t wallUs = 0;
+        int64_t steadyUs = 0;
+        uint64_t responseHash = 0;
+    };
+
+    static RequestClock &clock()
+    {
+        thread_local RequestClock requestClock;
+        return requestClock;
+    }
+
+    static int64_t toUs(std::chrono::nanoseconds duration)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    }
+
+    void run()
+    {
+        std::string batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (running || !pending.empty())
+        {
+            wake.wait_for(lock, std::chrono::milliseconds(100), [this]
+                          { return !running || pending.size() >= options.flushBytes; });
+            if (pending.empty())
+            {
+                continue;
+            }
+            batch.swap(pending);
+            lock.unlock();
+            std::fwrite(batch.data(), 1, batch.size(), file);
+            std::fflush(file);
+            batch.clear();
+            lock.lock();
+        }
+    }
+
+public:
+    ~TrafficCapture()
+    {
+        stop();
+    }
+
+    bool enabled() const { return running; }
+
+    void start(const CaptureOptions &captureOptions)
+    {
+        options = captureOptions;
+        if (!options.enabled || running)
+        {
+            return;
+        }
+        file = std::fopen(options.path.c_str(), "ab");
+        if (!file)
+        {
+            return;
+        }
+        running = true;
+        writer = std::thread(&TrafficCapture::run, this);
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running)
+            {
+                return;
+            }
+            running = false;
+        }
+        wake.notify_one();
+        writer.join();
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    // Pre-routing: remember when this request arrived
+    void begin()
+    {
+        if (!running)
+        {
+            return;
+        }
+        RequestClock &requestClock = clock();
+        requestClock.wallUs = toUs(std::chrono::system_clock::now().time_since_epoch());
+        requestClock.steadyUs = toUs(std::chrono::steady_clock::now().time_since_epoch());
+        requestClock.responseHash = 0;
+    }
+
+    // Post-routing, before compression, so replays compare the identity body
+    void responseReady(const std::string &responseBody)
+    {
+        if (running)
+        {
+            clock().responseHash = fnv1a64(responseBody);
+        }
+    }
+
+    // After the response is written. `client` is the peer address, which replay
+    // uses to keep each client's requests in order. `headers` is any multimap of
+    // header name to value, such as httplib::Headers.
+    template <typename Headers>
+    void record(const std::string &client, const std::string &method, const std::string &target,
+                const Headers &headers, const std::string &body, int status)
+    {
+        if (!running)
+        {
+            return;
+        }
+        const RequestClock &requestClock = clock();
+        int64_t latencyUs = toUs(std::chrono::steady_clock::now().time_since_epoch()) - requestClock.steadyUs;
+
+        bool wakeWriter;
+        std::string line;
+        line.reserve(160 + target.size() + body.size());
+        line += R"({"ts_us":)";
+        line += std::to_string(requestClock.wallUs);
+        line += R"(,"client":")";
+        appendJsonEscaped(line, client);
+        line += R"(","method":")";
+        appendJsonEscaped(line, method);
+        line += R"(","path":")";
+        appendJsonEscaped(line, target);
+        line += R"(","headers":{)";
+        bool firstHeader = true;
+        for (const char *name : replayedHeaders)
+        {
+            auto it = headers.find(name);
+            if (it == headers.end())
+            {
+                continue;
+            }
+            line += firstHeader ? "\"" : ",\"";
+            firstHeader = false;
+            line += name;
+            line += R"(":")";
+            appendJsonEscaped(line, it->second);
+            line += '"';
+        }
+        line += R"(},"body":")";
+        if (body.find("\"password\"") != std::string::npos)
+            appendJsonEscaped(line, redactJsonField(body, "password", redactedPassword));
+        else
+            appendJsonEscaped(line, body);
+        line += R"(","status":)";
+        line += std::to_string(status);
+        line += R"(,"latency_us":)";
+        line += std::to_string(latencyUs);
+        line += R"(,"response_hash":")";
+        line += std::to_string(requestClock.responseHash);
+        line += "\"}\n";
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (pending.size() + line.size() > options.maxPendingBytes)
+            {
+                droppedRequests.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            pending += line;
+            wakeWriter = pending.size() >= options.flushBytes;
+        }
+        capturedRequests.fetch_add(1, std::memory_order_relaxed);
+        if (wakeWriter)
+        {
+            wake.notify_one();
+        }
+    }
+
+    uint64_t captured() const { return capturedRequests.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return droppedRequests.load(std::memory_order_relaxed); }
+};
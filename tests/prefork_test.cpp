@@ -0,0 +1,291 @@
+// Checks the state pre-fork workers share, with real forked processes: seat
+// claims racing across workers, rate limit budgets shared between them, the
+// reload gate the supervisor uses after a crash, and the request ID ranges each
+// worker incarnation gets. Linux only; exits non-zero on any failed check.
+//
+//   prefork_test
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <new>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/prefork.h"
+#include "src/rate_limiter.h"
+#include "src/seat_inventory.h"
+
+namespace
+{
+    constexpr int workers = 4;
+
+    int failures = 0;
+
+    bool check(bool ok, const std::string &what)
+    {
+        std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what.c_str());
+        if (!ok)
+        {
+            ++failures;
+        }
+        std::fflush(stdout);
+        return ok;
+    }
+
+    // Zeroed counters every forked worker sees
+    template <typename T>
+    T *sharedArray(size_t count)
+    {
+        void *mapping = mmap(nullptr, count * sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        T *items = static_cast<T *>(mapping);
+        for (size_t i = 0; i < count; ++i)
+        {
+            new (&items[i]) T();
+        }
+        return items;
+    }
+
+    // Forks `count` processes running `fn(index)` and waits for them all; false if
+    // any of them did not exit cleanly
+    template <typename Fn>
+    bool forkAll(int count, Fn fn)
+    {
+        std::vector<pid_t> pids;
+        for (int i = 0; i < count; ++i)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                fn(i);
+                _exit(0);
+            }
+            pids.push_back(pid);
+        }
+        bool clean = true;
+        for (pid_t pid : pids)
+        {
+            int status = 0;
+            waitpid(pid, &status, 0);
+            clean = clean && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        return clean;
+    }
+
+    // Every worker tries every seat; each seat must end up claimed exactly once
+    void doubleBooking()
+    {
+        constexpr int seats = 300;
+        SeatInventory inventory;
+        if (!check(inventory.create(16, workers), "seat inventory mapped"))
+        {
+            return;
+        }
+        inventory.addFlight(7, seats);
+        std::atomic<int> *wins = sharedArray<std::atomic<int>>(seats + 1);
+
+        bool clean = forkAll(workers, [&](int index)
+                             {
+            inventory.attachWorker(index);
+            // Each worker walks the seats from a different start so they collide
+            for (int i = 0; i < seats; ++i)
+            {
+                int seat = (i + index * seats / workers) % seats + 1;
+                SeatInventory::Update update(&inventory);
+                if (inventory.claim(7, seat) == SeatInventory::Claim::Claimed)
+                    wins[seat].fetch_add(1);
+            } });
+        check(clean, "claiming workers exited cleanly");
+
+        int once = 0;
+        for (int seat = 1; seat <= seats; ++seat)
+        {
+            once += wins[seat].load() == 1;
+        }
+        check(once == seats, "every seat claimed by exactly one worker (" + std::to_string(once) + "/" +
+                                 std::to_string(seats) + ")");
+        std::vector<int> taken;
+        check(inventory.takenSeats(7, taken) && taken.size() == seats, "shared bits show every seat taken");
+        check(inventory.claim(7, seats + 1) == SeatInventory::Claim::NoSuchSeat, "seat past the capacity is refused");
+        munmap(wins, (seats + 1) * sizeof(std::atomic<int>));
+    }
+
+    // One client's burst is shared by all workers, not granted once per worker
+    void sharedRateLimits()
+    {
+        RateLimitOptions options;
+        options.booking = {1.0, 10.0};
+        int64_t now = RateLimiter::nowNs();
+        SharedRateLimits table;
+        if (!check(table.create(1024, now), "rate limit table mapped"))
+        {
+            return;
+        }
+        std::atomic<int> *allowed = sharedArray<std::atomic<int>>(2);
+
+        bool clean = forkAll(workers, [&](int)
+                             {
+            RateLimiter limiter(options);
+            limiter.share(&table);
+            for (int i = 0; i < 10; ++i)
+            {
+                // A fixed clock, so no tokens refill during the test
+                allowed[0].fetch_add(limiter.acquire(RouteClass::BookingWrite, "acct:a@example.com", now).allowed);
+                allowed[1].fetch_add(limiter.acquire(RouteClass::BookingWrite, "acct:b@example.com", now).allowed);
+            } });
+        check(clean, "limiting workers exited cleanly");
+        check(allowed[0].load() == 10, "one burst of 10 across " + std::to_string(workers) + " workers (" +
+                                           std::to_string(allowed[0].load()) + " allowed)");
+        check(allowed[1].load() == 10, "another client keeps its own burst (" + std::to_string(allowed[1].load()) +
+                                           " allowed)");
+        munmap(allowed, 2 * sizeof(std::atomic<int>));
+    }
+
+    // The supervisor waits for updates in progress and holds off new ones
+    void reloadGate()
+    {
+        SeatInventory inventory;
+        if (!check(inventory.create(16, 2), "gate inventory mapped"))
+        {
+            return;
+        }
+        inventory.addFlight(1, 10);
+        std::atomic<int> *stage = sharedArray<std::atomic<int>>(2);
+
+        pid_t holder = fork();
+        if (holder == 0)
+        {
+            // Worker 0: holds an update open for a while
+            inventory.attachWorker(0);
+            {
+                SeatInventory::Update update(&inventory);
+                stage[0].store(1);
+                std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            }
+            _exit(0);
+        }
+        while (stage[0].load() != 1)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        check(!inventory.beginReload(-1, 50), "reload times out while an update is in progress");
+        inventory.endReload();
+        auto start = std::chrono::steady_clock::now();
+        check(inventory.beginReload(-1, 5000), "reload proceeds once the update finishes");
+        check(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(100),
+              "reload waited for the update");
+
+        pid_t blocked = fork();
+        if (blocked == 0)
+        {
+            // Worker 1: must not start an update until the reload ends
+            inventory.attachWorker(1);
+            {
+                SeatInventory::Update update(&inventory);
+                stage[1].store(1);
+            }
+            _exit(0);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        check(stage[1].load() == 0, "new update held off during the reload");
+        inventory.endReload();
+        int status = 0;
+        waitpid(blocked, &status, 0);
+        check(stage[1].load() == 1, "held update runs after the reload");
+        waitpid(holder, &status, 0);
+
+        // A worker that dies inside an update leaves its count behind
+        pid_t dying = fork();
+        if (dying == 0)
+        {
+            inventory.attachWorker(0);
+            new SeatInventory::Update(&inventory); // never destroyed
+            _exit(1);
+        }
+        waitpid(dying, &status, 0);
+        check(!inventory.beginReload(-1, 50), "a dead worker's update blocks an ordinary reload");
+        inventory.endReload();
+        check(inventory.beginReload(0, 50), "reload for the lost worker drops its count");
+        inventory.endReload();
+        munmap(stage, 2 * sizeof(std::atomic<int>));
+    }
+
+    // Worker incarnations get disjoint request ID ranges, also across restarts
+    void requestIdPartitioning()
+    {
+        constexpr uint64_t rangeSize = (uint64_t(1) << 32) - 1; // sequence 1 .. 2^32-1
+        std::set<uint64_t> firsts;
+        bool disjoint = true;
+        bool belowJsonLimit = true;
+        for (int worker : {0, 1, 2, 63, 1023})
+        {
+            for (int generation : {0, 1, 2, 2047})
+            {
+                uint64_t first = workerFirstRequestId(worker, generation);
+                belowJsonLimit = belowJsonLimit && first + rangeSize - 1 < (uint64_t(1) << 53);
+                auto next = firsts.lower_bound(first);
+                disjoint = disjoint && (next == firsts.end() || *next >= first + rangeSize) &&
+                           (next == firsts.begin() || *std::prev(next) + rangeSize <= first);
+                firsts.insert(first);
+            }
+        }
+        check(disjoint, "ID ranges of workers and generations do not overlap");
+        check(belowJsonLimit, "IDs stay below 2^53");
+        check(workerFirstRequestId(1, 2048) == workerFirstRequestId(1, 0), "generation wraps at 2048");
+
+        // Through the supervisor: worker 0 crashes once and comes back as generation 1
+        uint64_t *seen = sharedArray<uint64_t>(workers + 1);
+        std::atomic<int> *runs = sharedArray<std::atomic<int>>(1);
+        std::atomic<int> *lost = sharedArray<std::atomic<int>>(1);
+        PreforkSupervisor supervisor(
+            workers,
+            [&](int index, int generation)
+            {
+                seen[generation == 0 ? index : workers] = workerFirstRequestId(index, generation);
+                if (index == 0 && generation == 0)
+                {
+                    _exit(1); // dies straight after start
+                }
+                if (runs->fetch_add(1) + 1 == workers)
+                {
+                    kill(getppid(), SIGTERM);
+                }
+                pause();
+                return 0;
+            },
+            [&](int)
+            { lost->fetch_add(1); });
+        supervisor.run();
+
+        std::set<uint64_t> distinct(seen, seen + workers + 1);
+        check(lost->load() >= 1, "supervisor reported the crashed worker");
+        check(distinct.size() == workers + 1 && !distinct.count(0),
+              "restarted worker got a fresh ID range (" + std::to_string(distinct.size()) + " distinct)");
+        munmap(seen, (workers + 1) * sizeof(uint64_t));
+        munmap(runs, sizeof(std::atomic<int>));
+        munmap(lost, sizeof(std::atomic<int>));
+    }
+}
+
+int main()
+{
+    doubleBooking();
+    sharedRateLimits();
+    reloadGate();
+    requestIdPartitioning();
+
+    std::printf("%s: %d failed\n", failures ? "FAILED" : "passed", failures);
+    return failures ? 1 : 0;
+}
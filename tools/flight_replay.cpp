@@ -0,0 +1,324 @@
+// Replays a capture written by CombinedServer (FLIGHT_CAPTURE=1) against a running
+// server, keeping the recorded inter-arrival gaps scaled by --speed, and reports
+// throughput, latency percentiles and responses that differ from the capture.
+// Latency runs from when a request was due to be sent, not from when a worker
+// got to it, so a slow server shows up as queueing instead of being hidden by it.
+//
+// By default requests go out one at a time in capture order, so a replay is
+// deterministic. With --concurrency N each captured client is pinned to one of N
+// connections, which keeps its own requests (register, login, book, cancel) in
+// order while different clients overlap.
+//
+//   flight_replay requests.jsonl [--host localhost] [--port 8080]
+//                 [--speed 1|N|max] [--concurrency 1]
+//
+// Every replayed request comes from this one host, so start the server with
+// FLIGHT_RATE_LIMIT=0; otherwise the per-IP budgets turn most of them into 429s.
+
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/hash.h"
+#include "src/traffic_capture.h"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct CapturedRequest
+{
+    int64_t timestampUs;
+    std::string client;
+    std::string method;
+    std::string path;
+    httplib::Headers headers;
+    std::string body;
+    int status;
+    uint64_t responseHash;
+};
+
+struct ReplayResult
+{
+    Clock::time_point scheduledAt;
+    int64_t latencyUs = 0;
+    bool failed = false;
+    bool skipped = false; // a method this tool cannot send
+    bool statusMismatch = false;
+    bool bodyMismatch = false;
+};
+
+static std::vector<CapturedRequest> loadCapture(const std::string &path)
+{
+    std::vector<CapturedRequest> requests;
+    std::ifstream in(path);
+    if (!in)
+    {
+        throw std::runtime_error("Can't open capture file: " + path);
+    }
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line))
+    {
+        ++lineNumber;
+        if (line.empty())
+        {
+            continue;
+        }
+        try
+        {
+            json record = json::parse(line);
+            httplib::Headers headers;
+            for (const auto &[name, value] : record.value("headers", json::object()).items())
+            {
+                headers.emplace(name, value.get<std::string>());
+            }
+            requests.push_back({record.at("ts_us").get<int64_t>(),
+                                record.value("client", ""),
+                                record.at("method").get<std::string>(),
+                                record.at("path").get<std::string>(),
+                                std::move(headers),
+                                record.value("body", ""),
+                                record.value("status", 0),
+                                std::stoull(record.value("response_hash", "0"))});
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Skipping line " << lineNumber << ": " << e.what() << std::endl;
+        }
+    }
+
+    std::stable_sort(requests.begin(), requests.end(), [](const CapturedRequest &a, const CapturedRequest &b)
+                     { return a.timestampUs < b.timestampUs; });
+    return requests;
+}
+
+static bool replayable(const std::string &method)
+{
+    for (const char *known : {"GET", "HEAD", "POST", "PUT", "PATCH", "DELETE", "OPTIONS"})
+    {
+        if (method == known)
+            return true;
+    }
+    return false;
+}
+
+// Only called for replayable() methods
+static httplib::Result send(httplib::Client &client, const CapturedRequest &request)
+{
+    const char *contentType = "application/json";
+    if (request.method == "POST")
+        return client.Post(request.path, request.headers, request.body, contentType);
+    if (request.method == "PUT")
+        return client.Put(request.path, request.headers, request.body, contentType);
+    if (request.method == "PATCH")
+        return client.Patch(request.path, request.headers, request.body, contentType);
+    if (request.method == "DELETE")
+        return client.Delete(request.path, request.headers, request.body, contentType);
+    if (request.method == "HEAD")
+        return client.Head(request.path, request.headers);
+    if (request.method == "OPTIONS")
+        return client.Options(request.path, request.headers);
+    return client.Get(request.path, request.headers);
+}
+
+static int64_t percentile(const std::vector<int64_t> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: flight_replay <capture.jsonl> [--host H] [--port P] "
+                     "[--speed 1|N|max] [--concurrency 1]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string capturePath = argv[1];
+    std::string host = "localhost";
+    int port = 8080;
+    double speed = 1.0; // 0 means as fast as possible
+    int concurrency = 1;
+
+    for (int i = 2; i < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        if (i + 1 == argc)
+        {
+            std::cerr << "Missing value for " << flag << std::endl;
+            return 1;
+        }
+        std::string value = argv[i + 1];
+        if (flag == "--host")
+            host = value;
+        else if (flag == "--port")
+            port = std::stoi(value);
+        else if (flag == "--speed")
+            speed = value == "max" ? 0.0 : std::stod(value);
+        else if (flag == "--concurrency")
+            concurrency = std::max(1, std::stoi(value));
+        else
+        {
+            std::cerr << "Unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<CapturedRequest> requests;
+    try
+    {
+        requests = loadCapture(capturePath);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (requests.empty())
+    {
+        std::cerr << "Capture is empty" << std::endl;
+        return 1;
+    }
+
+    std::vector<ReplayResult> results(requests.size());
+
+    // One ordered queue per connection; a client always lands on the same one
+    struct Lane
+    {
+        std::deque<size_t> queue;
+        std::condition_variable ready;
+    };
+    std::vector<Lane> lanes(static_cast<size_t>(concurrency));
+    std::mutex queueMutex;
+    bool dispatchDone = false;
+
+    // Workers issue requests as the dispatcher releases them; each keeps its own
+    // keep-alive connection.
+    std::vector<std::thread> workers;
+    for (int w = 0; w < concurrency; ++w)
+    {
+        workers.emplace_back([&, w]
+                             {
+            Lane &lane = lanes[static_cast<size_t>(w)];
+            httplib::Client client(host, port);
+            client.set_keep_alive(true);
+            for (;;)
+            {
+                size_t index;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    lane.ready.wait(lock, [&] { return dispatchDone || !lane.queue.empty(); });
+                    if (lane.queue.empty())
+                        return;
+                    index = lane.queue.front();
+                    lane.queue.pop_front();
+                }
+
+                const CapturedRequest &request = requests[index];
+                ReplayResult &result = results[index];
+                auto response = send(client, request);
+                result.latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - result.scheduledAt).count();
+                if (!response)
+                {
+                    result.failed = true;
+                    continue;
+                }
+                result.statusMismatch = response->status != request.status;
+                result.bodyMismatch = fnv1a64(response->body) != request.responseHash;
+            } });
+    }
+
+    // Dispatcher: release each request at its recorded offset, scaled by speed.
+    // At max speed every request is due at once.
+    auto replayStart = Clock::now();
+    int64_t firstTimestamp = requests.front().timestampUs;
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        if (!replayable(requests[i].method))
+        {
+            results[i].skipped = true;
+            continue;
+        }
+        Clock::time_point scheduledAt = replayStart;
+        if (speed > 0)
+        {
+            auto offset = std::chrono::microseconds(static_cast<int64_t>((requests[i].timestampUs - firstTimestamp) / speed));
+            scheduledAt += offset;
+            std::this_thread::sleep_until(scheduledAt);
+        }
+        Lane &lane = lanes[std::hash<std::string>{}(requests[i].client) % lanes.size()];
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            results[i].scheduledAt = scheduledAt;
+            lane.queue.push_back(i);
+        }
+        lane.ready.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        dispatchDone = true;
+    }
+    for (Lane &lane : lanes)
+    {
+        lane.ready.notify_all();
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    double elapsedSeconds = std::chrono::duration<double>(Clock::now() - replayStart).count();
+
+    std::vector<int64_t> latencies;
+    size_t failed = 0, skipped = 0, statusMismatches = 0, bodyMismatches = 0;
+    for (const ReplayResult &result : results)
+    {
+        if (result.skipped)
+        {
+            ++skipped;
+            continue;
+        }
+        if (result.failed)
+        {
+            ++failed;
+            continue;
+        }
+        latencies.push_back(result.latencyUs);
+        statusMismatches += result.statusMismatch;
+        bodyMismatches += result.bodyMismatch;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("requests          %zu\n", requests.size());
+    std::printf("elapsed           %.3f s\n", elapsedSeconds);
+    std::printf("throughput        %.1f req/s\n", requests.size() / elapsedSeconds);
+    std::printf("latency p50       %lld us\n", static_cast<long long>(percentile(latencies, 0.50)));
+    std::printf("latency p90       %lld us\n", static_cast<long long>(percentile(latencies, 0.90)));
+    std::printf("latency p99       %lld us\n", static_cast<long long>(percentile(latencies, 0.99)));
+    std::printf("latency max       %lld us\n", static_cast<long long>(latencies.empty() ? 0 : latencies.back()));
+    std::printf("failed            %zu\n", failed);
+    std::printf("skipped           %zu\n", skipped);
+    std::printf("status mismatches %zu\n", statusMismatches);
+    std::printf("body mismatches   %zu\n", bodyMismatches);
+
+    return failed == 0 && statusMismatches == 0 ? 0 : 2;
+}
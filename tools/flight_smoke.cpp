@@ -0,0 +1,182 @@
+// End-to-end check against a running server: registers and logs in a user, adds
+// two flights, then books, replays, assigns, exports, reschedules and cancels
+// through the JSON API. Every request goes over one keep-alive connection, so a handler that
+// runs before its body is read (or leaves it on the socket) shows up as a failed
+// check rather than passing on a fresh connection. Point it at a scratch server;
+// it leaves its users, flights and bookings behind.
+//
+//   flight_smoke [--host localhost] [--port 8080]
+
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+using json = nlohmann::json;
+
+namespace
+{
+    int failures = 0;
+
+    bool check(bool ok, const std::string &what, const httplib::Result *result = nullptr)
+    {
+        if (ok)
+        {
+            std::printf("ok    %s\n", what.c_str());
+            return true;
+        }
+        ++failures;
+        if (!result)
+            std::printf("FAIL  %s\n", what.c_str());
+        else if (*result)
+            std::printf("FAIL  %s: status %d, body %s\n", what.c_str(), (*result)->status, (*result)->body.c_str());
+        else
+            std::printf("FAIL  %s: %s\n", what.c_str(), httplib::to_string(result->error()).c_str());
+        return false;
+    }
+
+    bool expectStatus(const httplib::Result &result, int status, const std::string &what)
+    {
+        return check(result && result->status == status, what, &result);
+    }
+
+    // The flight_id GET /api/flights lists for `flightNumber`, or 0
+    int findFlight(httplib::Client &client, const std::string &flightNumber)
+    {
+        auto result = client.Get("/api/flights");
+        if (!expectStatus(result, 200, "GET /api/flights"))
+        {
+            return 0;
+        }
+        for (const json &flight : json::parse(result->body, nullptr, false))
+        {
+            if (flight.value("flight_number", "") == flightNumber)
+                return flight.value("flight_id", 0);
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string host = "localhost";
+    int port = 8080;
+    for (int i = 1; i < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        if (i + 1 == argc)
+        {
+            std::cerr << "Missing value for " << flag << std::endl;
+            return 1;
+        }
+        if (flag == "--host")
+            host = argv[i + 1];
+        else if (flag == "--port")
+            port = std::stoi(argv[i + 1]);
+        else
+        {
+            std::cerr << "Unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    httplib::Client client(host, port);
+    client.set_keep_alive(true);
+
+    std::string suffix = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                            std::chrono::system_clock::now().time_since_epoch())
+                                            .count());
+    std::string email = "smoke" + suffix + "@example.com";
+    const char *contentType = "application/json";
+
+    json user = {{"name", "Smoke Test"}, {"email", email}, {"password", "smoke-password"}};
+    expectStatus(client.Post("/register", user.dump(), contentType), 200, "POST /register");
+    user.erase("name");
+    expectStatus(client.Post("/login", user.dump(), contentType), 200, "POST /login");
+
+    std::string flightNumbers[2] = {"SMK" + suffix + "A", "SMK" + suffix + "B"};
+    int flightIds[2] = {};
+    for (int i = 0; i < 2; ++i)
+    {
+        json flight = {{"flight_number", flightNumbers[i]},
+                       {"destination", "Smoke City"},
+                       {"departure_date", "2030-01-01"},
+                       {"total_seats", 120},
+                       {"class_type", "Economy"},
+                       {"price", 99.5}};
+        expectStatus(client.Post("/api/flights", flight.dump(), contentType), 200, "POST /api/flights");
+        flightIds[i] = findFlight(client, flightNumbers[i]);
+    }
+    if (!check(flightIds[0] && flightIds[1], "new flights are listed"))
+    {
+        return 1;
+    }
+
+    json booking = {{"flight_id", flightIds[0]},
+                    {"passenger_name", "Smoke Test"},
+                    {"passenger_email", email},
+                    {"seat_number", 1}};
+    httplib::Headers idempotencyKey = {{"Idempotency-Key", "smoke-" + suffix}};
+    auto first = client.Post("/api/bookings", idempotencyKey, booking.dump(), contentType);
+    expectStatus(first, 200, "POST /api/bookings");
+    auto retry = client.Post("/api/bookings", idempotencyKey, booking.dump(), contentType);
+    check(retry && first && retry->status == first->status && retry->body == first->body &&
+              retry->get_header_value("Idempotent-Replayed") == "true",
+          "POST /api/bookings retry is replayed", &retry);
+
+    json party = {{"passenger_name", "Smoke Test"}, {"passenger_email", email}, {"party_size", 2}};
+    std::string flightPath = "/api/flights/" + std::to_string(flightIds[0]);
+    expectStatus(client.Post(flightPath + "/assign", party.dump(), contentType), 200, "POST /api/flights/{id}/assign");
+
+    auto seats = client.Get(flightPath + "/seats");
+    if (expectStatus(seats, 200, "GET /api/flights/{id}/seats"))
+    {
+        json free = json::parse(seats->body, nullptr, false);
+        check(free.is_array() && free.size() == 117 && std::find(free.begin(), free.end(), 1) == free.end(),
+              "seat list covers all 120 seats minus the 3 booked", &seats);
+    }
+
+    int bookingId = 0;
+    auto bookings = client.Get("/api/bookings?email=" + email);
+    if (expectStatus(bookings, 200, "GET /api/bookings"))
+    {
+        for (const json &row : json::parse(bookings->body, nullptr, false))
+        {
+            if (row.value("seat_number", 0) == 1 && row.value("flight_number", "") == flightNumbers[0])
+                bookingId = row.value("booking_id", 0);
+        }
+    }
+    check(bookingId != 0, "booking is listed", &bookings);
+
+    // Streamed as a chunked, gzip-compressed array; the client inflates it
+    auto exported = client.Get("/api/bookings/export", {{"Accept-Encoding", "gzip"}});
+    if (expectStatus(exported, 200, "GET /api/bookings/export"))
+    {
+        json all = json::parse(exported->body, nullptr, false);
+        bool listed = false;
+        if (all.is_array())
+        {
+            for (const json &row : all)
+                listed = listed || row.value("booking_id", 0) == bookingId;
+        }
+        check(listed && exported->get_header_value("Content-Encoding") == "gzip" &&
+                  exported->get_header_value("Transfer-Encoding") == "chunked",
+              "booking export is a chunked gzip array including the booking", &exported);
+    }
+
+    if (bookingId != 0)
+    {
+        json reschedule = {{"booking_id", bookingId}, {"new_flight_id", flightIds[1]}, {"new_date", "2030-01-02"}};
+        expectStatus(client.Put("/api/bookings/reschedule", reschedule.dump(), contentType), 200,
+                     "PUT /api/bookings/reschedule");
+        expectStatus(client.Delete("/api/bookings/" + std::to_string(bookingId)), 200, "DELETE /api/bookings/{id}");
+    }
+
+    expectStatus(client.Get("/api/no-such-route"), 404, "unknown route is 404");
+
+    std::printf("%d failed\n", failures);
+    return failures == 0 ? 0 : 2;
+}